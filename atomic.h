@@ -5,13 +5,13 @@
 
 namespace NJK {
 
-    inline bool TrySub(std::atomic<size_t>& counter) {
+    inline bool TrySub(std::atomic<size_t>& counter, size_t n = 1) {
         size_t count = counter.load();
         while (true) {
-            if (!count) {
+            if (count < n) {
                 return false;
             }
-            if (counter.compare_exchange_weak(count, count - 1)) {
+            if (counter.compare_exchange_weak(count, count - n)) {
                 return true;
             }
         }
@@ -1,30 +1,135 @@
 #include "bitset.h"
 
+#include <algorithm>
+#include <bit>
+
 namespace NJK {
 
     TODO("This is for little-endian only")
 
+    namespace {
+        // count bits from pos, count <= 64 - pos
+        ui64 MakeMask(size_t pos, size_t count) {
+            return (count == 64 ? ~ui64{0} : (ui64{1} << count) - 1) << pos;
+        }
+    }
+
     i32 TBlockBitSet::FindUnset() const {
-        // TODO Buf must be aligned to machine word
-        const size_t* buf = reinterpret_cast<const size_t*>(Buf_.Data());
-        for (size_t i = 0; i < Buf_.Size() / sizeof(size_t); ++i) {
-            auto v = buf[i];
-            if (v != (size_t)-1) {
-                // TODO Binary search here
-                for (size_t j = 0; j < sizeof(size_t); ++j) {
-                    if ((v & 0xff) != 0xff) {
-                        for (size_t k = 0; k < 8; ++k) {
-                            if ((v & 1) == 0) {
-                                return i * sizeof(size_t) * 8 + j * 8 + k;
-                            }
-                            v >>= 1;
-                        }
-                    }
-                    v >>= 8;
+        const size_t size = Buf_.Size() * 8;
+        const size_t pos = FindUnset(0, size);
+        return pos == size ? -1 : pos;
+    }
+
+    size_t TBlockBitSet::FindSet(size_t first, size_t last) const {
+        while (first < last) {
+            const size_t shift = first % WordBits;
+            const TWord state = Word(first / WordBits).load(std::memory_order::relaxed) >> shift;
+            if (state) {
+                return std::min(last, first + std::countr_zero(state));
+            }
+            first += WordBits - shift;
+        }
+        return last;
+    }
+
+    size_t TBlockBitSet::FindUnset(size_t first, size_t last) const {
+        while (first < last) {
+            const size_t shift = first % WordBits;
+            const TWord state = ~Word(first / WordBits).load(std::memory_order::relaxed) >> shift;
+            if (state) {
+                return std::min(last, first + std::countr_zero(state));
+            }
+            first += WordBits - shift;
+        }
+        return last;
+    }
+
+    i32 TBlockBitSet::TrySetBit(bool useHint) {
+        const size_t count = GetWordCount();
+        const size_t hint = useHint ? Hint_.load(std::memory_order::relaxed) : 0;
+        bool prefixFull = true;
+        for (size_t n = 0; n < count; ++n) {
+            const size_t idx = (hint + n) % count;
+            auto word = Word(idx);
+            TWord state = word.load(std::memory_order::relaxed);
+            while (state != ~TWord{0}) {
+                // Lowest unset bit
+                const TWord bit = ~state & (state + 1);
+                if (word.compare_exchange_weak(state, state | bit, std::memory_order::acq_rel, std::memory_order::relaxed)) {
+                    return idx * WordBits + std::countr_zero(bit);
                 }
             }
+            // Full, next searches start after it until the wrap around
+            if (idx + 1 == count) {
+                prefixFull = false;
+            } else if (prefixFull) {
+                size_t expected = idx;
+                Hint_.compare_exchange_strong(expected, idx + 1, std::memory_order::relaxed);
+            }
         }
         return -1;
     }
 
-}
\ No newline at end of file
+    i32 TBlockBitSet::TrySetRange(size_t count) {
+        Y_VERIFY(count);
+        const size_t size = Buf_.Size() * 8;
+        size_t first = FindUnset(0, size);
+        while (first + count <= size) {
+            size_t busy = FindSet(first, first + count);
+            if (busy == first + count) {
+                busy = TrySetBits(first, first + count);
+                if (busy == first + count) {
+                    return first;
+                }
+            }
+            first = FindUnset(busy + 1, size);
+        }
+        return -1;
+    }
+
+    size_t TBlockBitSet::TrySetBits(size_t first, size_t last) {
+        for (size_t pos = first; pos < last; ) {
+            const size_t shift = pos % WordBits;
+            const size_t n = std::min(WordBits - shift, last - pos);
+            const TWord mask = MakeMask(shift, n);
+            auto word = Word(pos / WordBits);
+            TWord state = word.load(std::memory_order::relaxed);
+            do {
+                if (state & mask) {
+                    UnsetBits(first, pos);
+                    return pos + std::countr_zero((state & mask) >> shift);
+                }
+            } while (!word.compare_exchange_weak(state, state | mask, std::memory_order::acq_rel, std::memory_order::relaxed));
+            pos += n;
+        }
+        return last;
+    }
+
+    void TBlockBitSet::UnsetBits(size_t first, size_t last) {
+        if (first == last) {
+            return;
+        }
+        for (size_t pos = first; pos < last; ) {
+            const size_t shift = pos % WordBits;
+            const size_t n = std::min(WordBits - shift, last - pos);
+            Word(pos / WordBits).fetch_and(~MakeMask(shift, n), std::memory_order::acq_rel);
+            pos += n;
+        }
+        LowerHint(first / WordBits);
+    }
+
+    void TBlockBitSet::LowerHint(size_t wordIdx) {
+        size_t hint = Hint_.load(std::memory_order::relaxed);
+        while (wordIdx < hint && !Hint_.compare_exchange_weak(hint, wordIdx, std::memory_order::relaxed)) {
+        }
+    }
+
+    void TBlockBitSet::CopyTo(TFixedBuffer& dst) const {
+        Y_ENSURE(Buf_.Size() == dst.Size());
+        auto* out = reinterpret_cast<TWord*>(dst.MutableData());
+        for (size_t i = 0; i < GetWordCount(); ++i) {
+            out[i] = Word(i).load(std::memory_order::relaxed);
+        }
+    }
+
+}
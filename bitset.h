@@ -30,45 +30,36 @@ namespace NJK {
         //    Page_ = new uint8_t[ByteSize];
         //}
 
+        // Test, Set, Unset and TrySet* are atomic and may run concurrently
+
         bool Test(size_t pos) const {
-            const auto& b = reinterpret_cast<const uint8_t&>(Buf_.Data()[pos / 8]);
-            return static_cast<bool>(b & static_cast<uint8_t>(1 << (pos % 8))) != 0;
+            return Word(pos / WordBits).load(std::memory_order::relaxed) & (TWord{1} << (pos % WordBits));
         }
 
         void Set(size_t pos, bool value = true) {
-            //Y_TODO("atomic");
-            auto& b = reinterpret_cast<uint8_t&>(Buf_.MutableData()[pos / 8]);
+            const TWord bit = TWord{1} << (pos % WordBits);
             if (value) {
-                b |= static_cast<uint8_t>(1 << (pos % 8));
+                Word(pos / WordBits).fetch_or(bit, std::memory_order::acq_rel);
             } else {
-                b &= static_cast<uint8_t>(0b11111111 ^ (1 << (pos % 8)));
+                Word(pos / WordBits).fetch_and(~bit, std::memory_order::acq_rel);
+                LowerHint(pos / WordBits);
             }
         }
 
-        //ui32 TrySetBit(size_t hint = 0) {
-        //    for (size_t i = hint; i < Buf_.Size() / sizeof(size_t); ++i) {
-        //        size_t* wordPtr = reinterpret_cast<size_t*>(Buf_.Data()) + i;
-        //        auto& word = reinterpret_cast<std::atomic<size_t>&>(*wordPtr);
-        //        size_t state = word.load();
-        //        while (true)
-        //            if (state == ~(size_t)0) {
-        //                break;
-        //            }
-        //            size_t inv = ~state;
-        //            size_t newState = ~((inv - 1) & inv);
-        //            Y_TODO("calc bit positiion convert to idx to return");
-        //            if (word.compare_exchange_strong(state, newState)) {
-        //                return idx;
-        //            }
-        //        }
-        //    }
-        //    return -1;
-        //}
-
         void Unset(size_t pos) {
             Set(pos, false);
         }
 
+        // Sets some unset bit (the lowest one without contention), -1 if all are set.
+        // Without hint the search starts from the first word
+        i32 TrySetBit(bool useHint = true);
+        // Sets count unset bits in a row, returns the first one or -1
+        i32 TrySetRange(size_t count);
+
+        // Snapshot of concurrently modified bits
+        void CopyTo(TFixedBuffer& dst) const;
+
+        // Not concurrent with anything
         const TFixedBuffer& Buf() const {
             return Buf_;
         }
@@ -88,8 +79,34 @@ namespace NJK {
     public:
         //static const constexpr size_t ByteSize = 4096;
 
+    private:
+        using TWord = ui64;
+        static constexpr size_t WordBits = sizeof(TWord) * 8;
+
+        size_t GetWordCount() const {
+            return Buf_.Size() / sizeof(TWord);
+        }
+
+        // Buf is aligned to its size
+        std::atomic_ref<TWord> Word(size_t idx) const {
+            return std::atomic_ref<TWord>(reinterpret_cast<TWord*>(const_cast<char*>(Buf_.Data()))[idx]);
+        }
+
+        // First set/unset bit in [first, last), last if none
+        size_t FindSet(size_t first, size_t last) const;
+        size_t FindUnset(size_t first, size_t last) const;
+
+        // Sets all bits of [first, last) or none if some is already set,
+        // returns last or position of that set bit
+        size_t TrySetBits(size_t first, size_t last);
+        void UnsetBits(size_t first, size_t last);
+
+        void LowerHint(size_t wordIdx);
+
     private:
         TFixedBuffer Buf_;
+        // Words before it were seen full, so search starts here
+        std::atomic<size_t> Hint_ = 0;
     };
 
 }
\ No newline at end of file
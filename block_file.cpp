@@ -0,0 +1,700 @@
+#include "block_file.h"
+
+#include <algorithm>
+#include <limits>
+#include <climits>
+#include <thread>
+#include <utility>
+
+namespace NJK {
+
+    template <typename F>
+    void TBlockDirectIoFile::ForEachRun(const std::vector<size_t>& blockIdxs, F&& f) {
+        for (size_t i = 0; i < blockIdxs.size();) {
+            size_t count = 1;
+            while (i + count < blockIdxs.size()
+                && blockIdxs[i + count] == blockIdxs[i] + count
+                && count < IOV_MAX)
+            {
+                ++count;
+            }
+            f(i, count);
+            i += count;
+        }
+    }
+
+    size_t TBlockDirectIoFile::ReadBlocks(const std::vector<TFixedBuffer*>& bufs, const std::vector<size_t>& blockIdxs) const {
+        Y_ENSURE(bufs.size() == blockIdxs.size());
+        std::vector<iovec> iov;
+        iov.reserve(bufs.size());
+        for (auto* buf : bufs) {
+            Y_ENSURE(buf->Size() == BlockSize_);
+            iov.push_back({buf->MutableData(), BlockSize_});
+        }
+
+        size_t syscalls = 0;
+        ForEachRun(blockIdxs, [&](size_t first, size_t count) {
+            Y_ENSURE(File_.ReadV(&iov[first], count, BlockSize_ * blockIdxs[first]) == BlockSize_ * count);
+            ++syscalls;
+        });
+        return syscalls;
+    }
+
+    size_t TBlockDirectIoFile::WriteBlocks(const std::vector<const TFixedBuffer*>& bufs, const std::vector<size_t>& blockIdxs) {
+        Y_ENSURE(bufs.size() == blockIdxs.size());
+        std::vector<iovec> iov;
+        iov.reserve(bufs.size());
+        for (auto* buf : bufs) {
+            Y_ENSURE(buf->Size() == BlockSize_);
+            iov.push_back({const_cast<char*>(buf->Data()), BlockSize_});
+        }
+
+        size_t syscalls = 0;
+        ForEachRun(blockIdxs, [&](size_t first, size_t count) {
+            Y_ENSURE(File_.WriteV(&iov[first], count, BlockSize_ * blockIdxs[first]) == BlockSize_ * count);
+            ++syscalls;
+        });
+        return syscalls;
+    }
+
+    TCachedBlockFile::TCachedBlockFile(TBlockDirectIoFile& file, const TSettings& settings)
+        : File_(file)
+        , Settings_(settings)
+    {
+        Y_ENSURE(Settings_.MaxFlushRun > 0 && Settings_.MaxFlushRun <= IOV_MAX);
+        Y_ENSURE(!Settings_.ReadaheadMax || (Settings_.ReadaheadMin > 0 && Settings_.ReadaheadMin <= Settings_.ReadaheadMax));
+
+        ShardCount_ = Settings_.Shards ? Settings_.Shards : std::max(std::thread::hardware_concurrency(), 1u);
+        if (Settings_.Capacity) {
+            ShardCount_ = std::clamp<size_t>(Settings_.Capacity / TSettings::MinShardCapacity, 1, ShardCount_);
+        }
+        Shards_.reset(new TShard[ShardCount_]);
+        for (size_t i = 0; i < ShardCount_; ++i) {
+            Shards_[i].Capacity = (Settings_.Capacity + ShardCount_ - 1) / ShardCount_;
+        }
+
+        DirtyLimit_ = Settings_.Capacity
+            ? std::max<size_t>(Settings_.Capacity * Settings_.MaxDirtyRatio, 1)
+            : std::numeric_limits<size_t>::max();
+
+        if (Settings_.FlushInterval.count()) {
+            Flusher_ = std::thread([this] {
+                FlusherLoop();
+            });
+        }
+    }
+
+    TCachedBlockFile::~TCachedBlockFile() {
+        if (Prefetcher_.joinable()) {
+            {
+                std::unique_lock g(PrefetchLock_);
+                PrefetchStopping_ = true;
+            }
+            PrefetchCondVar_.notify_all();
+            Prefetcher_.join();
+        }
+        if (Flusher_.joinable()) {
+            {
+                std::unique_lock g(DirtyLock_);
+                Stopping_ = true;
+            }
+            DirtyCondVar_.notify_all();
+            Flusher_.join();
+        }
+        // Flusher or writers keep dirty blocks count about DirtyLimit_
+        // (unbounded only without Capacity), so this is bounded.
+        // Failed blocks are still dirty and retried, only new errors throw
+        FlushError_ = nullptr;
+        Sync();
+    }
+
+    void TCachedBlockFile::Sync() {
+        // Blocks under modification are waited for between passes, so
+        // neither FlushLock_ nor Flushing blocks are held while waiting
+        std::vector<ui32> busy;
+        while (true) {
+            busy.clear();
+            FlushDirty(&busy);
+            if (busy.empty()) {
+                break;
+            }
+            for (const ui32 blockIdx : busy) {
+                // Dirty blocks aren't evicted, so it's there unless written already
+                if (auto page = GetShard(blockIdx).Cache.Find(blockIdx)) {
+                    auto g = MakeGuard(page->Lock);
+                    while (page->InModify) {
+                        page->CondVar.Wait(page->Lock);
+                    }
+                }
+            }
+        }
+
+        std::exception_ptr error;
+        {
+            std::unique_lock g(DirtyLock_);
+            error = std::exchange(FlushError_, nullptr);
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        File_.Sync();
+    }
+
+    TCachedBlockFile::TStats TCachedBlockFile::GetStats() const {
+        TStats ret;
+        for (size_t i = 0; i < ShardCount_; ++i) {
+            const TShard& shard = Shards_[i];
+            ret.Hits += shard.Hits.load(std::memory_order::relaxed);
+            ret.Misses += shard.Misses.load(std::memory_order::relaxed);
+            ret.Evictions += shard.Evictions.load(std::memory_order::relaxed);
+            ret.DirtySkips += shard.DirtySkips.load(std::memory_order::relaxed);
+            ret.Overflows += shard.Overflows.load(std::memory_order::relaxed);
+        }
+        ret.Reads = Reads_.load(std::memory_order::relaxed);
+        ret.FlushedBlocks = FlushedBlocks_.load(std::memory_order::relaxed);
+        ret.FlushWrites = FlushWrites_.load(std::memory_order::relaxed);
+        ret.Prefetched = Prefetched_.load(std::memory_order::relaxed);
+        ret.PrefetchHits = PrefetchHits_.load(std::memory_order::relaxed);
+        return ret;
+    }
+
+    size_t TCachedBlockFile::GetResidentCount() const {
+        size_t ret = 0;
+        for (size_t i = 0; i < ShardCount_; ++i) {
+            ret += Shards_[i].ResidentCount.load(std::memory_order::relaxed);
+        }
+        return ret;
+    }
+
+    namespace {
+        TDirectIoQueue& ThreadLocalIoQueue() {
+            static thread_local TDirectIoQueue queue(64);
+            return queue;
+        }
+    }
+
+    std::vector<TCachedBlockFile::TPage<false>> TCachedBlockFile::GetBlocks(const std::vector<size_t>& blockIdxs) {
+        std::vector<TRawBlockPtr> pages;
+        pages.reserve(blockIdxs.size());
+        std::vector<TRawBlock*> toLoad;
+
+        for (const size_t blockIdx : blockIdxs) {
+            TShard& shard = GetShard(blockIdx);
+            auto page = shard.Cache[blockIdx];
+            {
+                auto g = MakeGuard(page->Lock);
+                ++page->Pinned;
+                if (page->DataLoaded) {
+                    shard.Hits.fetch_add(1, std::memory_order::relaxed);
+                    OnHit(page.Ptr());
+                } else if (!page->Loading) {
+                    shard.Misses.fetch_add(1, std::memory_order::relaxed);
+                    page->BlockIdx = blockIdx;
+                    if (page->Buf.Size() == 0) {
+                        page->Buf = AllocateBuffer(shard, page.Ptr());
+                    }
+                    page->Loading = true;
+                    toLoad.push_back(page.Ptr());
+                }
+            }
+            pages.push_back(std::move(page));
+        }
+
+        std::vector<TPage<false>> ret;
+        ret.reserve(pages.size());
+        // Pages not passed to ret yet are unpinned if something throws
+        Y_DEFER([&] {
+            for (size_t i = ret.size(); i < pages.size(); ++i) {
+                auto g = MakeGuard(pages[i]->Lock);
+                --pages[i]->Pinned;
+            }
+        });
+
+        LoadBlocks(toLoad);
+
+        for (auto& page : pages) {
+            bool load = false;
+            {
+                // Wait for loads started by other threads
+                auto g = MakeGuard(page->Lock);
+                while (page->Loading) {
+                    page->CondVar.Wait(page->Lock);
+                }
+                if (!page->DataLoaded) {
+                    // Load failed in other thread
+                    page->Loading = true;
+                    load = true;
+                }
+            }
+            if (load) {
+                LoadBlocks({page.Ptr()});
+            }
+            ret.emplace_back(std::move(page));
+        }
+        return ret;
+    }
+
+    void TCachedBlockFile::Prefetch(std::vector<size_t> blockIdxs) {
+        std::sort(blockIdxs.begin(), blockIdxs.end());
+        blockIdxs.erase(std::unique(blockIdxs.begin(), blockIdxs.end()), blockIdxs.end());
+
+        // Pinned prefetched blocks must not wash out the cache
+        if (const size_t capacity = Settings_.Capacity) {
+            const size_t limit = std::max<size_t>(capacity / 4, 1);
+            const size_t inFlight = PrefetchInFlight_.load(std::memory_order::relaxed);
+            blockIdxs.resize(std::min(blockIdxs.size(), limit - std::min(limit, inFlight)));
+        }
+
+        std::vector<TRawBlockPtr> batch;
+        for (const size_t blockIdx : blockIdxs) {
+            TShard& shard = GetShard(blockIdx);
+            auto page = shard.Cache[blockIdx];
+            {
+                auto g = MakeGuard(page->Lock);
+                if (page->DataLoaded || page->Loading) {
+                    continue;
+                }
+                page->BlockIdx = blockIdx;
+                if (page->Buf.Size() == 0) {
+                    page->Buf = AllocateBuffer(shard, page.Ptr());
+                }
+                page->Loading = true;
+                page->Prefetched = true;
+                ++page->Pinned;
+            }
+            batch.push_back(std::move(page));
+        }
+        if (batch.empty()) {
+            return;
+        }
+        Prefetched_.fetch_add(batch.size(), std::memory_order::relaxed);
+        PrefetchInFlight_.fetch_add(batch.size(), std::memory_order::relaxed);
+
+        std::call_once(PrefetcherStarted_, [this] {
+            Prefetcher_ = std::thread([this] {
+                PrefetcherLoop();
+            });
+        });
+        {
+            std::unique_lock g(PrefetchLock_);
+            for (auto& page : batch) {
+                PrefetchQueue_.push_back(std::move(page));
+            }
+        }
+        PrefetchCondVar_.notify_one();
+    }
+
+    void TCachedBlockFile::PrefetcherLoop() {
+        std::vector<TRawBlockPtr> batch;
+        std::vector<TRawBlock*> pages;
+        while (true) {
+            {
+                std::unique_lock g(PrefetchLock_);
+                PrefetchCondVar_.wait(g, [this] {
+                    return PrefetchStopping_ || !PrefetchQueue_.empty();
+                });
+                if (PrefetchQueue_.empty()) {
+                    return;
+                }
+                // Everything queued goes in flight at once
+                batch.swap(PrefetchQueue_);
+            }
+
+            pages.clear();
+            for (auto& page : batch) {
+                pages.push_back(page.Ptr());
+            }
+            try {
+                LoadBlocks(pages);
+            } catch (...) {
+                // Failed blocks are left not loaded, readers will retry
+            }
+
+            for (auto& page : batch) {
+                auto g = MakeGuard(page->Lock);
+                --page->Pinned;
+                if (!page->DataLoaded) {
+                    page->Prefetched = false;
+                }
+            }
+            PrefetchInFlight_.fetch_sub(batch.size(), std::memory_order::relaxed);
+            batch.clear();
+        }
+    }
+
+    void TCachedBlockFile::Readahead(size_t blockIdx) {
+        if (!Settings_.ReadaheadMax) {
+            return;
+        }
+
+        size_t from = 0;
+        size_t count = 0;
+        {
+            std::unique_lock g(ReadaheadLock_);
+            auto stream = std::find_if(Streams_.begin(), Streams_.end(), [blockIdx](const TReadaheadStream& s) {
+                return s.End && s.Next <= blockIdx && blockIdx < std::max(s.End, s.Next + 1);
+            });
+            if (stream == Streams_.end()) {
+                Streams_[NextStream_++ % Streams_.size()] = {blockIdx + 1, blockIdx + 1, 0};
+                return;
+            }
+
+            stream->Next = blockIdx + 1;
+            stream->End = std::max(stream->End, stream->Next);
+            // Refill when less than half of the window is ahead of reader
+            if (stream->End - stream->Next > stream->Window / 2) {
+                return;
+            }
+            stream->Window = std::clamp(stream->Window * 2, Settings_.ReadaheadMin, Settings_.ReadaheadMax);
+            from = stream->End;
+            count = stream->Window;
+            stream->End += count;
+        }
+
+        // fstat only when the window passes the known end
+        size_t size = KnownSizeInBlocks_.load(std::memory_order::relaxed);
+        if (from + count > size) {
+            size = File_.GetSizeInBlocks();
+            KnownSizeInBlocks_.store(size, std::memory_order::relaxed);
+        }
+        if (from >= size) {
+            return;
+        }
+        count = std::min(count, size - from);
+
+        std::vector<size_t> blockIdxs(count);
+        for (size_t i = 0; i < count; ++i) {
+            blockIdxs[i] = from + i;
+        }
+        Prefetch(std::move(blockIdxs));
+    }
+
+    void TCachedBlockFile::LoadBlocks(const std::vector<TRawBlock*>& pages) {
+        if (pages.empty()) {
+            return;
+        }
+
+        const size_t blockSize = File_.GetBlockSize();
+
+        std::vector<TRawBlock*> sorted(pages);
+        std::sort(sorted.begin(), sorted.end(), [](const TRawBlock* lhs, const TRawBlock* rhs) {
+            return lhs->BlockIdx < rhs->BlockIdx;
+        });
+
+        // Runs of adjacent blocks, iov must be alive till completion
+        std::vector<iovec> iov;
+        iov.reserve(sorted.size());
+        std::vector<size_t> blockIdxs;
+        blockIdxs.reserve(sorted.size());
+        for (auto* page : sorted) {
+            iov.push_back({page->Buf.MutableData(), blockSize});
+            blockIdxs.push_back(page->BlockIdx);
+        }
+        struct TRun {
+            size_t First = 0;
+            size_t Count = 0;
+        };
+        std::vector<TRun> runs;
+        TBlockDirectIoFile::ForEachRun(blockIdxs, [&runs](size_t first, size_t count) {
+            runs.push_back({first, count});
+        });
+
+        auto& queue = ThreadLocalIoQueue();
+        std::vector<TDirectIoQueue::TCompletion> completions;
+        std::vector<bool> done(runs.size());
+        bool failed = false;
+
+        auto finish = [&](size_t runIdx, bool ok) {
+            const auto& run = runs[runIdx];
+            done[runIdx] = true;
+            failed |= !ok;
+            for (size_t i = run.First; i < run.First + run.Count; ++i) {
+                TRawBlock* page = sorted[i];
+                {
+                    auto g = MakeGuard(page->Lock);
+                    page->Loading = false;
+                    page->DataLoaded = ok;
+                }
+                page->CondVar.NotifyAll();
+            }
+        };
+        auto complete = [&] {
+            for (const auto& c : completions) {
+                finish(c.Cookie, c.Result == (ssize_t)(runs[c.Cookie].Count * blockSize));
+            }
+        };
+        auto drain = [&] {
+            while (queue.GetInFlight()) {
+                queue.Wait(queue.GetInFlight(), completions);
+                complete();
+            }
+        };
+
+        try {
+            for (size_t i = 0; i < runs.size(); ++i) {
+                if (queue.IsFull()) {
+                    queue.Wait(1, completions);
+                    complete();
+                }
+                const auto& run = runs[i];
+                File_.ReadBlocksAsync(queue, &iov[run.First], run.Count, blockIdxs[run.First], i);
+            }
+            Reads_.fetch_add(runs.size(), std::memory_order::relaxed);
+            drain();
+        } catch (...) {
+            // Kernel must be done with buffers before waiters get the pages back
+            drain();
+            for (size_t i = 0; i < runs.size(); ++i) {
+                if (!done[i]) {
+                    finish(i, false);
+                }
+            }
+            throw;
+        }
+
+        if (failed) {
+            throw std::runtime_error("TCachedBlockFile: failed to read block");
+        }
+    }
+
+    TFixedBuffer TCachedBlockFile::AllocateBuffer(TShard& shard, TRawBlock* page) {
+        const size_t capacity = shard.Capacity;
+        if (!capacity) {
+            shard.ResidentCount.fetch_add(1, std::memory_order::relaxed);
+            return TFixedBuffer::Aligned(File_.GetBlockSize());
+        }
+
+        std::unique_lock g(shard.QueueLock);
+        Y_DEFER([&] {
+            page->Queue = EQueue::Probation;
+            shard.Probation.push_back(page);
+        });
+
+        if (shard.ResidentCount.load(std::memory_order::relaxed) < capacity) {
+            shard.ResidentCount.fetch_add(1, std::memory_order::relaxed);
+            return TFixedBuffer::Aligned(File_.GetBlockSize());
+        }
+
+        const size_t probationLimit = std::max<size_t>(capacity / 4, 1);
+
+        // Each block may be visited twice: first pass clears Referenced bit
+        size_t steps = 2 * (shard.Probation.size() + shard.Protected.size()) + 1;
+        while (steps--) {
+            const bool fromProbation = !shard.Probation.empty()
+                && (shard.Probation.size() >= probationLimit || shard.Protected.empty());
+            auto& queue = fromProbation ? shard.Probation : shard.Protected;
+            if (queue.empty()) {
+                break;
+            }
+
+            TRawBlock* victim = queue.front();
+            queue.pop_front();
+
+            if (victim->Referenced.exchange(false, std::memory_order::relaxed)) {
+                victim->Queue = EQueue::Protected;
+                shard.Protected.push_back(victim);
+                continue;
+            }
+
+            TFixedBuffer buf = TFixedBuffer::Empty();
+            if (TryEvict(shard, victim, buf)) {
+                // victim is erased, don't touch it anymore
+                return buf;
+            }
+            queue.push_back(victim);
+        }
+
+        // Everything is pinned or busy, exceed capacity rather than deadlock
+        shard.Overflows.fetch_add(1, std::memory_order::relaxed);
+        shard.ResidentCount.fetch_add(1, std::memory_order::relaxed);
+        return TFixedBuffer::Aligned(File_.GetBlockSize());
+    }
+
+    bool TCachedBlockFile::TryEvict(TShard& shard, TRawBlock* victim, TFixedBuffer& buf) {
+        // Whole entry is erased, not only the buffer, so metadata is bounded too
+        return shard.Cache.TryEvict(victim->BlockIdx, [&](TRawBlock& page) {
+            // Never wait for victim lock: its owner may wait for QueueLock
+            if (!page.Lock.try_lock()) {
+                return false;
+            }
+            Y_DEFER([&page] {
+                page.Lock.unlock();
+            });
+
+            if (page.Pinned || page.Flushing) {
+                return false;
+            }
+
+            // No I/O here: lookups of the key wait while it's Dead. Dirty
+            // count is kept about DirtyLimit_, so there are clean victims
+            if (page.Dirty) {
+                shard.DirtySkips.fetch_add(1, std::memory_order::relaxed);
+                return false;
+            }
+
+            buf = std::move(page.Buf);
+            page.DataLoaded = false;
+            page.Prefetched = false;
+            shard.Evictions.fetch_add(1, std::memory_order::relaxed);
+            return true;
+        });
+    }
+
+    bool TCachedBlockFile::MarkDirty(ui32 blockIdx) {
+        bool notify = false;
+        bool overLimit = false;
+        {
+            std::unique_lock g(DirtyLock_);
+            if (DirtyBlocks_.empty()) {
+                OldestDirty_ = std::chrono::steady_clock::now();
+                notify = true; // flusher sleeps without deadline
+            }
+            DirtyBlocks_.push_back(blockIdx);
+            if (DirtyBlocks_.size() >= DirtyLimit_) {
+                notify = true;
+                overLimit = true;
+            }
+        }
+        if (!Flusher_.joinable()) {
+            return overLimit;
+        }
+        if (notify) {
+            DirtyCondVar_.notify_one();
+        }
+        return false;
+    }
+
+    void TCachedBlockFile::FlusherLoop() {
+        std::unique_lock g(DirtyLock_);
+        while (!Stopping_) {
+            if (DirtyBlocks_.empty()) {
+                DirtyCondVar_.wait(g);
+                continue;
+            }
+
+            const auto deadline = OldestDirty_ + Settings_.FlushInterval;
+            if (DirtyBlocks_.size() < DirtyLimit_ && std::chrono::steady_clock::now() < deadline) {
+                DirtyCondVar_.wait_until(g, deadline);
+                continue;
+            }
+
+            g.unlock();
+            const bool ok = FlushDirty();
+            g.lock();
+            if (!ok) {
+                // Failed blocks are queued again, don't spin on a broken disk
+                DirtyCondVar_.wait_for(g, Settings_.FlushInterval);
+            }
+        }
+    }
+
+    bool TCachedBlockFile::FlushDirty(std::vector<ui32>* busy) {
+        std::unique_lock f(FlushLock_);
+
+        std::vector<ui32> blocks;
+        {
+            std::unique_lock g(DirtyLock_);
+            blocks.swap(DirtyBlocks_);
+        }
+        std::sort(blocks.begin(), blocks.end());
+        blocks.erase(std::unique(blocks.begin(), blocks.end()), blocks.end());
+
+        std::vector<ui32> retry;
+        std::vector<ui32> failed;
+        std::vector<TRawBlockPtr> run;
+        for (size_t i = 0; i < blocks.size();) {
+            const ui32 first = blocks[i];
+            run.clear();
+            while (i < blocks.size() && blocks[i] == first + run.size() && run.size() < Settings_.MaxFlushRun) {
+                auto page = BeginFlush(blocks[i++], retry);
+                if (!page) {
+                    break;
+                }
+                run.push_back(std::move(page));
+            }
+            if (!run.empty() && !WriteRun(first, run)) {
+                for (size_t j = 0; j < run.size(); ++j) {
+                    failed.push_back(first + j);
+                }
+            }
+        }
+        if (busy) {
+            *busy = retry;
+        }
+        const bool ok = failed.empty();
+        retry.insert(retry.end(), failed.begin(), failed.end());
+
+        if (!retry.empty()) {
+            std::unique_lock g(DirtyLock_);
+            if (DirtyBlocks_.empty()) {
+                OldestDirty_ = std::chrono::steady_clock::now();
+            }
+            DirtyBlocks_.insert(DirtyBlocks_.end(), retry.begin(), retry.end());
+        }
+        return ok;
+    }
+
+    TCachedBlockFile::TRawBlockPtr TCachedBlockFile::BeginFlush(ui32 blockIdx, std::vector<ui32>& retry) {
+        auto page = GetShard(blockIdx).Cache.Find(blockIdx);
+        if (!page) {
+            return {};
+        }
+
+        auto g = MakeGuard(page->Lock);
+        // Never wait here: its modifier may wait for blocks of our run
+        if (page->InModify) {
+            retry.push_back(blockIdx);
+            return {};
+        }
+
+        // May be already written
+        if (!page->Dirty || !page->DataLoaded) {
+            return {};
+        }
+
+        page->Dirty = false;
+        page->Flushing = true;
+        ++page->Pinned;
+        return page;
+    }
+
+    bool TCachedBlockFile::WriteRun(ui32 firstBlockIdx, std::vector<TRawBlockPtr>& run) {
+        bool ok = true;
+        Y_DEFER([&] {
+            for (auto& page : run) {
+                {
+                    auto g = MakeGuard(page->Lock);
+                    page->Flushing = false;
+                    // Nobody modifies Flushing blocks, so it's still our data
+                    page->Dirty |= !ok;
+                    --page->Pinned;
+                }
+                page->CondVar.NotifyAll();
+            }
+        });
+
+        // Nobody modifies Flushing blocks, so we can read them without lock
+        std::vector<const TFixedBuffer*> bufs;
+        std::vector<size_t> blockIdxs;
+        for (size_t i = 0; i < run.size(); ++i) {
+            bufs.push_back(&run[i]->Buf);
+            blockIdxs.push_back(firstBlockIdx + i);
+        }
+        size_t writes = 0;
+        try {
+            writes = File_.WriteBlocks(bufs, blockIdxs);
+        } catch (...) {
+            ok = false;
+            std::unique_lock g(DirtyLock_);
+            if (!FlushError_) {
+                FlushError_ = std::current_exception();
+            }
+            return false;
+        }
+
+        FlushedBlocks_.fetch_add(run.size(), std::memory_order::relaxed);
+        FlushWrites_.fetch_add(writes, std::memory_order::relaxed);
+        return true;
+    }
+
+}
@@ -3,10 +3,18 @@
 #include "direct_io.h"
 #include "fixed_buffer.h"
 #include "hash_map.h"
+#include "lock.h"
 //#include <unordered_map>
 
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <memory>
 #include <mutex>
+#include <thread>
+#include <vector>
 #include <condition_variable>
 
 #include <iostream>
@@ -37,6 +45,26 @@ namespace NJK {
             Y_ENSURE(File_.Write(buf.Data(), BlockSize_, BlockSize_ * blockIdx) == BlockSize_);
         }
 
+        // bufs[i] is for block blockIdxs[i], runs of adjacent indexes are moved
+        // by one preadv/pwritev. Return number of syscalls made.
+        size_t ReadBlocks(const std::vector<TFixedBuffer*>& bufs, const std::vector<size_t>& blockIdxs) const;
+        size_t WriteBlocks(const std::vector<const TFixedBuffer*>& bufs, const std::vector<size_t>& blockIdxs);
+
+        // Completion result is BlockSize on success
+        void ReadBlockAsync(TDirectIoQueue& queue, TFixedBuffer& buf, size_t blockIdx, ui64 cookie) const {
+            Y_ENSURE(buf.Size() == BlockSize_);
+            queue.Read(File_, buf.MutableData(), BlockSize_, BlockSize_ * blockIdx, cookie);
+        }
+
+        // iov must be alive till completion, result is count * BlockSize on success
+        void ReadBlocksAsync(TDirectIoQueue& queue, const iovec* iov, size_t count, size_t firstBlockIdx, ui64 cookie) const {
+            queue.ReadV(File_, iov, count, BlockSize_ * firstBlockIdx, cookie);
+        }
+
+        void Sync() {
+            File_.Sync();
+        }
+
         size_t GetSizeInBlocks() const {
             size_t byteSize = File_.GetSize();
             Y_ENSURE(byteSize % BlockSize_ == 0);
@@ -57,36 +85,139 @@ namespace NJK {
             File_.Truncate(blockCount * BlockSize_);
         }
 
+        // Calls f(first, count) for each run of adjacent indexes (at most IOV_MAX long)
+        template <typename F>
+        static void ForEachRun(const std::vector<size_t>& blockIdxs, F&& f);
+
     private:
         TDirectIoFile File_;
         size_t BlockSize_{};
     };
 
+    struct TCachedBlockFileSettings {
+        size_t Capacity = 0; // in blocks, 0 means unbounded
+
+        // Background write-back of dirty blocks, disabled if zero
+        std::chrono::milliseconds FlushInterval{0};
+        float MaxDirtyRatio = 0.1; // of Capacity, wakes flusher before FlushInterval
+        size_t MaxFlushRun = 128; // adjacent dirty blocks coalesced into one pwritev
+
+        // Sequential readahead window (in blocks) doubles from Min to Max, 0 disables
+        size_t ReadaheadMin = 4;
+        size_t ReadaheadMax = 64;
+
+        // Independent partitions of the cache, 0 means one per hardware thread.
+        // Capped so that each shard holds at least MinShardCapacity blocks
+        size_t Shards = 0;
+        static constexpr size_t MinShardCapacity = 64;
+    };
+
+    // Page cache over TBlockDirectIoFile
+    //
+    // Blocks are spread over shards by index, each shard has its own hash map,
+    // eviction queues and counters on separate cache lines, so threads working
+    // with different blocks don't share anything but the read-only Shards_.
+    //
+    // Capacity is a soft limit on resident blocks (0 means unbounded), split
+    // evenly between shards. Replacement is 2Q-like per shard: freshly loaded
+    // blocks go to Probation queue and are promoted to Protected one only if
+    // they were touched again, so one-time scans can't wash out the hot set.
+    // Protected queue is a CLOCK (second chance by Referenced bit).
+    //
+    // Dirty blocks are written by flusher thread (if enabled) when they get
+    // older than FlushInterval or there are too many of them, by Sync() and
+    // in destructor. Without flusher the writer which exceeds the dirty limit
+    // writes them itself. Writers wait only for blocks which are written right now.
+    //
+    // Prefetch() and readahead load blocks in background prefetcher thread.
+    // Readers of a block being prefetched just wait for it as for any other
+    // load. Prefetched block isn't Referenced until it's touched twice, so
+    // readahead of a scan doesn't promote anything into Protected queue.
     class TCachedBlockFile {
     public:
-        TCachedBlockFile(TBlockDirectIoFile& file)
-            : File_(file)
-        {
-        }
+        using TSettings = TCachedBlockFileSettings;
+
+        struct TStats {
+            size_t Hits = 0;
+            size_t Misses = 0;
+            size_t Reads = 0; // read requests to disk, adjacent misses are read by one
+            size_t Evictions = 0;
+            size_t DirtySkips = 0; // dirty victims left to flusher or writers
+            size_t Overflows = 0; // no victim found (all pinned or dirty), capacity exceeded
+            size_t FlushedBlocks = 0;
+            size_t FlushWrites = 0; // FlushedBlocks / FlushWrites is coalescing ratio
+            size_t Prefetched = 0; // blocks loaded by Prefetch() and readahead
+            size_t PrefetchHits = 0; // first accesses to prefetched blocks
+
+            TStats& operator+= (const TStats& other) {
+                Hits += other.Hits;
+                Misses += other.Misses;
+                Reads += other.Reads;
+                Evictions += other.Evictions;
+                DirtySkips += other.DirtySkips;
+                Overflows += other.Overflows;
+                FlushedBlocks += other.FlushedBlocks;
+                FlushWrites += other.FlushWrites;
+                Prefetched += other.Prefetched;
+                PrefetchHits += other.PrefetchHits;
+                return *this;
+            }
+        };
 
-        ~TCachedBlockFile() {
-            Flush();
-        }
+        TCachedBlockFile(TBlockDirectIoFile& file, const TSettings& settings = {});
+        ~TCachedBlockFile();
+
+        // Barrier: blocks modified before the call are on disk after return.
+        // Must not be called with TPage<true> held by the calling thread.
+        // Throws if some write failed since the previous call, failed blocks
+        // stay dirty and are retried.
+        void Sync();
 
     private:
+        enum class EQueue: ui8 {
+            None,
+            Probation,
+            Protected,
+        };
+
         struct TRawBlock {
-            TNaiveSpinLock Lock;
+            TAdaptiveLock Lock;
             TCondVar CondVar;
             TFixedBuffer Buf = TFixedBuffer::Empty();
             bool DataLoaded = false;
+            bool Loading = false; // read is in flight, wait on CondVar
             bool Dirty = false;
             ui32 InModify = 0;
             bool Flushing = false;
+            bool Prefetched = false; // loaded ahead, not accessed yet
+
+            ui32 BlockIdx = 0;
+            ui32 Pinned = 0; // alive TPage count, pinned blocks are never evicted
+            std::atomic<bool> Referenced{false};
+            EQueue Queue = EQueue::None; // guarded by TShard::QueueLock
         };
 
         using TCache = THashMap<ui32, TRawBlock>;
         using TRawBlockPtr = TCache::TValuePtr;
 
+        // Buffers are allocated by the thread which missed, so with first-touch
+        // NUMA policy memory ends up near the threads using the shard
+        struct alignas(64) TShard {
+            TCache Cache;
+            size_t Capacity = 0;
+            std::atomic<size_t> ResidentCount{0};
+
+            std::mutex QueueLock; // lock order: TRawBlock::Lock -> QueueLock -> try_lock of victim
+            std::deque<TRawBlock*> Probation;
+            std::deque<TRawBlock*> Protected;
+
+            std::atomic<size_t> Hits{0};
+            std::atomic<size_t> Misses{0};
+            std::atomic<size_t> Evictions{0};
+            std::atomic<size_t> DirtySkips{0};
+            std::atomic<size_t> Overflows{0};
+        };
+
     public:
 
         template <bool Mutable>
@@ -98,7 +229,11 @@ namespace NJK {
             }
 
             ~TPage() {
+                if (!Page_) {
+                    return;
+                }
                 auto g = MakeGuard(Page_->Lock);
+                --Page_->Pinned;
                 if (Mutable) {
                     if (--Page_->InModify == 0) {
                         Page_->CondVar.NotifyAll();
@@ -128,43 +263,186 @@ namespace NJK {
             return ret;
         }
 
+        // For writers of whole block: missing block is not read from disk,
+        // it's zeroed instead
+        TPage<true> GetBlockForOverwrite(size_t blockIdx) {
+            TPage<true> ret{GetBlockImpl(blockIdx, true, true)};
+            return ret;
+        }
+
+        // Same as GetBlock for each index, but all misses are read concurrently
+        std::vector<TPage<false>> GetBlocks(const std::vector<size_t>& blockIdxs);
+
+        // Hint: start loading blocks in background and return immediately.
+        // Nothing is guaranteed, blocks may be skipped under memory pressure
+        void Prefetch(std::vector<size_t> blockIdxs);
+
+        TStats GetStats() const;
+
+        size_t GetCapacity() const {
+            return Settings_.Capacity;
+        }
+
+        size_t GetResidentCount() const;
+
+        size_t GetShardCount() const {
+            return ShardCount_;
+        }
+
     private:
-        TRawBlockPtr GetBlockImpl(size_t blockIdx, bool modify) {
-            TRawBlockPtr page{};
-            {
-                page = Cache_[blockIdx];
-            }
+        TShard& GetShard(size_t blockIdx) const {
+            return Shards_[blockIdx % ShardCount_];
+        }
 
-            auto guard = MakeGuard(page->Lock);
-            if (page->Buf.Size() == 0) {
-                page->Buf = TFixedBuffer::Aligned(File_.GetBlockSize()); // TODO BETTER
-            }
-            if (!page->DataLoaded) {
-                File_.ReadBlock(page->Buf, blockIdx);
-                page->DataLoaded = true;
-            }
-            if (modify) {
-                while (page->Flushing) {
+        TRawBlockPtr GetBlockImpl(size_t blockIdx, bool modify, bool overwrite = false) {
+            TShard& shard = GetShard(blockIdx);
+            TRawBlockPtr page = shard.Cache[blockIdx];
+
+            // Pin (and InModify) go to TPage on return, released if something throws
+            bool pinned = false;
+            bool modifying = false;
+            Y_DEFER([&] {
+                if (!pinned) {
+                    return;
+                }
+                auto g = MakeGuard(page->Lock);
+                --page->Pinned;
+                if (modifying && --page->InModify == 0) {
+                    page->CondVar.NotifyAll();
+                }
+            });
+
+            bool readahead = false;
+            bool flush = false;
+            {
+                auto guard = MakeGuard(page->Lock);
+                ++page->Pinned;
+                pinned = true;
+                while (page->Loading) {
                     page->CondVar.Wait(page->Lock);
                 }
-                page->Dirty = true;
-                ++page->InModify; // we want simultaneously modify different inodes in same block
+                if (!page->DataLoaded) {
+                    shard.Misses.fetch_add(1, std::memory_order::relaxed);
+                    page->BlockIdx = blockIdx;
+                    if (page->Buf.Size() == 0) {
+                        page->Buf = AllocateBuffer(shard, page.Ptr());
+                    }
+                    if (overwrite) {
+                        page->Buf.FillZeroes();
+                    } else {
+                        File_.ReadBlock(page->Buf, blockIdx);
+                        Reads_.fetch_add(1, std::memory_order::relaxed);
+                        readahead = true;
+                    }
+                    page->DataLoaded = true;
+                } else {
+                    shard.Hits.fetch_add(1, std::memory_order::relaxed);
+                    readahead = OnHit(page.Ptr());
+                }
+                if (modify) {
+                    while (page->Flushing) {
+                        page->CondVar.Wait(page->Lock);
+                    }
+                    if (!page->Dirty) {
+                        page->Dirty = true;
+                        flush = MarkDirty(blockIdx);
+                    }
+                    ++page->InModify; // we want simultaneously modify different inodes in same block
+                    modifying = true;
+                }
+            }
+            // Only misses and first hits of prefetched blocks, so hot path is untouched
+            if (readahead) {
+                Readahead(blockIdx);
             }
+            // Blocks under modification (this one too) are left for later
+            if (flush) {
+                FlushDirty();
+            }
+            pinned = false;
             return page;
         }
 
-        void Flush() {
-            Cache_.Iterate([this](ui32 blockIdx, TRawBlock& block) {
-                if (block.Dirty) {
-                    File_.WriteBlock(block.Buf, blockIdx);
-                    block.Dirty = false;
-                }
-            });
+        // Called under page->Lock, returns true if page was prefetched
+        bool OnHit(TRawBlock* page) {
+            if (page->Prefetched) {
+                page->Prefetched = false;
+                PrefetchHits_.fetch_add(1, std::memory_order::relaxed);
+                return true;
+            }
+            page->Referenced.store(true, std::memory_order::relaxed);
+            return false;
         }
 
+        // Sequential access detector, prefetches ahead of the stream
+        void Readahead(size_t blockIdx);
+        void PrefetcherLoop();
+
+        // Called under page->Lock, admits page into shard Probation queue
+        TFixedBuffer AllocateBuffer(TShard& shard, TRawBlock* page);
+
+        // Pages must be pinned and marked Loading. Adjacent blocks are read
+        // by one request, all requests are in flight at once
+        void LoadBlocks(const std::vector<TRawBlock*>& pages);
+
+        // Erases victim from cache if nobody uses it and it's clean, takes its buffer
+        bool TryEvict(TShard& shard, TRawBlock* victim, TFixedBuffer& buf);
+
+        // Called under page->Lock. Returns true if there is no flusher and
+        // dirty blocks reached DirtyLimit_, so the writer must flush them
+        bool MarkDirty(ui32 blockIdx);
+
+        // Writes dirty blocks in runs of adjacent ones. Blocks under modification
+        // are left dirty till the next time and also returned in busy. Failed
+        // writes are left dirty too and recorded for Sync(), returns false then
+        bool FlushDirty(std::vector<ui32>* busy = nullptr);
+        TRawBlockPtr BeginFlush(ui32 blockIdx, std::vector<ui32>& retry);
+        bool WriteRun(ui32 firstBlockIdx, std::vector<TRawBlockPtr>& run);
+        void FlusherLoop();
+
     private:
         TBlockDirectIoFile& File_;
-        THashMap<ui32, TRawBlock> Cache_;
+
+        const TSettings Settings_;
+        size_t ShardCount_ = 1;
+        std::unique_ptr<TShard[]> Shards_;
+
+        std::atomic<size_t> Reads_{0};
+        std::atomic<size_t> FlushedBlocks_{0};
+        std::atomic<size_t> FlushWrites_{0};
+
+        std::mutex DirtyLock_; // lock order: TRawBlock::Lock -> DirtyLock_
+        std::condition_variable DirtyCondVar_;
+        std::vector<ui32> DirtyBlocks_;
+        std::chrono::steady_clock::time_point OldestDirty_;
+        size_t DirtyLimit_ = 0;
+        bool Stopping_ = false;
+        std::exception_ptr FlushError_; // first failed background write, reported by Sync()
+
+        std::mutex FlushLock_; // one flush pass at a time
+        std::thread Flusher_;
+
+        struct TReadaheadStream {
+            size_t Next = 0; // expected next access
+            size_t End = 0; // prefetched up to
+            size_t Window = 0;
+        };
+        std::mutex ReadaheadLock_;
+        std::array<TReadaheadStream, 8> Streams_{}; // few concurrent scans per file
+        // File size as readahead saw it last time, files don't shrink
+        std::atomic<size_t> KnownSizeInBlocks_{0};
+        size_t NextStream_ = 0;
+
+        std::atomic<size_t> Prefetched_{0};
+        std::atomic<size_t> PrefetchHits_{0};
+        std::atomic<size_t> PrefetchInFlight_{0};
+
+        std::mutex PrefetchLock_;
+        std::condition_variable PrefetchCondVar_;
+        std::vector<TRawBlockPtr> PrefetchQueue_; // pinned and Loading
+        bool PrefetchStopping_ = false;
+        std::once_flag PrefetcherStarted_;
+        std::thread Prefetcher_;
     };
 
     class TCachedBlockFileRegion {
@@ -175,12 +453,26 @@ namespace NJK {
         {
         }
 
+        auto GetBlocks(std::vector<size_t> blockIdxs) {
+            for (auto& idx : blockIdxs) {
+                idx += Offset_;
+            }
+            return File_.GetBlocks(blockIdxs);
+        }
+
+        size_t GetOffset() const {
+            return Offset_;
+        }
+
         auto GetBlock(size_t blockIdx) {
             return File_.GetBlock(blockIdx + Offset_);
         }
         auto GetMutableBlock(size_t blockIdx) {
             return File_.GetMutableBlock(blockIdx + Offset_);
         }
+        auto GetBlockForOverwrite(size_t blockIdx) {
+            return File_.GetBlockForOverwrite(blockIdx + Offset_);
+        }
 
     private:
         TCachedBlockFile& File_;
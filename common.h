@@ -24,6 +24,7 @@ namespace NJK {
     using i16 = int16_t;
     using i32 = int32_t;
 
+    using ui64 = uint64_t;
     using ui32 = uint32_t;
     using ui16 = uint16_t;
     using ui8 = uint8_t;
@@ -1,4 +1,5 @@
 #include "direct_io.h"
+#include "io_uring.h"
 
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -29,6 +30,18 @@ namespace NJK {
         return ret;
     }
 
+    size_t TDirectIoFile::ReadV(const iovec* iov, size_t count, off_t offset) const {
+        ssize_t ret = preadv(Fd_, iov, count, offset);
+        Y_ENSURE(ret != -1);
+        return ret;
+    }
+
+    size_t TDirectIoFile::WriteV(const iovec* iov, size_t count, off_t offset) {
+        ssize_t ret = pwritev(Fd_, iov, count, offset);
+        Y_ENSURE(ret != -1);
+        return ret;
+    }
+
     size_t TDirectIoFile::GetSize() const {
         struct stat stat{};
         Y_SYSCALL(fstat(Fd_, &stat));
@@ -38,4 +51,103 @@ namespace NJK {
     void TDirectIoFile::Truncate(size_t size) {
         Y_SYSCALL(ftruncate(Fd_, size));
     }
-}
\ No newline at end of file
+
+    void TDirectIoFile::Sync() {
+        Y_SYSCALL(fdatasync(Fd_));
+    }
+
+    TDirectIoQueue::TDirectIoQueue(size_t depth, bool tryAsync)
+        : Depth_(depth)
+    {
+        Y_ENSURE(depth > 0);
+        if (tryAsync && TIoUring::IsSupported()) {
+            Ring_ = std::make_unique<TIoUring>(depth);
+        }
+    }
+
+    TDirectIoQueue::~TDirectIoQueue() {
+        // Kernel may still write into buffers, which are going to be freed
+        std::vector<TCompletion> completions;
+        while (InFlight_) {
+            Wait(InFlight_, completions);
+        }
+    }
+
+    bool TDirectIoQueue::RegisterBuffers(const std::vector<TFixedBuffer*>& buffers) {
+        if (!Ring_) {
+            return false;
+        }
+        std::vector<iovec> iov;
+        iov.reserve(buffers.size());
+        for (auto* buf : buffers) {
+            iov.push_back({buf->MutableData(), buf->Size()});
+        }
+        return Ring_->RegisterBuffers(iov);
+    }
+
+    void TDirectIoQueue::Read(const TDirectIoFile& file, char* dst, size_t count, off_t offset, ui64 cookie, int fixedBufIdx) {
+        Y_ENSURE(InFlight_ < Depth_);
+        if (Ring_) {
+            Y_ENSURE(Ring_->PrepareRead(file.Fd_, dst, count, offset, cookie, fixedBufIdx));
+        } else {
+            const ssize_t ret = pread(file.Fd_, dst, count, offset);
+            Ready_.push_back({cookie, ret == -1 ? -errno : ret});
+        }
+        ++InFlight_;
+    }
+
+    void TDirectIoQueue::Write(TDirectIoFile& file, const char* src, size_t count, off_t offset, ui64 cookie, int fixedBufIdx) {
+        Y_ENSURE(InFlight_ < Depth_);
+        if (Ring_) {
+            Y_ENSURE(Ring_->PrepareWrite(file.Fd_, src, count, offset, cookie, fixedBufIdx));
+        } else {
+            const ssize_t ret = pwrite(file.Fd_, src, count, offset);
+            Ready_.push_back({cookie, ret == -1 ? -errno : ret});
+        }
+        ++InFlight_;
+    }
+
+    void TDirectIoQueue::ReadV(const TDirectIoFile& file, const iovec* iov, size_t count, off_t offset, ui64 cookie) {
+        Y_ENSURE(InFlight_ < Depth_);
+        if (Ring_) {
+            Y_ENSURE(Ring_->PrepareReadV(file.Fd_, iov, count, offset, cookie));
+        } else {
+            const ssize_t ret = preadv(file.Fd_, iov, count, offset);
+            Ready_.push_back({cookie, ret == -1 ? -errno : ret});
+        }
+        ++InFlight_;
+    }
+
+    void TDirectIoQueue::Submit() {
+        if (Ring_) {
+            Ring_->Submit();
+        }
+    }
+
+    size_t TDirectIoQueue::Wait(size_t minCount, std::vector<TCompletion>& completions) {
+        Y_ENSURE(minCount <= InFlight_);
+        completions.clear();
+
+        if (!Ring_) {
+            completions.swap(Ready_);
+            InFlight_ -= completions.size();
+            return completions.size();
+        }
+
+        auto onComplete = [&completions](ui64 cookie, int result) {
+            completions.push_back({cookie, result});
+        };
+
+        Ring_->Reap(onComplete);
+        while (completions.size() < minCount) {
+            Ring_->Submit(minCount - completions.size());
+            Ring_->Reap(onComplete);
+        }
+        if (completions.empty()) {
+            Ring_->Submit();
+        }
+        InFlight_ -= completions.size();
+        return completions.size();
+    }
+
+}
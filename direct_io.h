@@ -1,11 +1,17 @@
 #pragma once
 
 #include "common.h"
+#include "fixed_buffer.h"
 
+#include <memory>
 #include <string>
+#include <vector>
+#include <sys/uio.h>
 
 namespace NJK {
 
+    class TIoUring;
+
     class TDirectIoFile {
     public:
         TDirectIoFile(const std::string& path);
@@ -17,11 +23,73 @@ namespace NJK {
         size_t Read(char* dst, size_t count, off_t offset) const;
         size_t Write(const char* dst, size_t count, off_t offset);
 
+        // count must not exceed IOV_MAX
+        size_t ReadV(const iovec* iov, size_t count, off_t offset) const;
+        size_t WriteV(const iovec* iov, size_t count, off_t offset);
+
         size_t GetSize() const;
         void Truncate(size_t size);
+        void Sync();
 
     private:
+        friend class TDirectIoQueue;
+
         int Fd_ = -1;
     };
 
+    // Asynchronous direct I/O with up to Depth requests in flight.
+    // Uses io_uring if possible, otherwise requests are executed
+    // synchronously right in Read/Write. Not thread-safe.
+    class TDirectIoQueue {
+    public:
+        struct TCompletion {
+            ui64 Cookie = 0;
+            ssize_t Result = 0; // bytes or -errno
+        };
+
+        explicit TDirectIoQueue(size_t depth = 32, bool tryAsync = true);
+        ~TDirectIoQueue();
+
+        TDirectIoQueue(const TDirectIoQueue&) = delete;
+        TDirectIoQueue& operator= (const TDirectIoQueue&) = delete;
+
+        bool IsAsync() const {
+            return (bool)Ring_;
+        }
+
+        size_t GetDepth() const {
+            return Depth_;
+        }
+
+        size_t GetInFlight() const {
+            return InFlight_;
+        }
+
+        bool IsFull() const {
+            return InFlight_ == Depth_;
+        }
+
+        // Buffer index in Read/Write is position in this vector.
+        // Returns false if not registered, plain Read/Write still work
+        bool RegisterBuffers(const std::vector<TFixedBuffer*>& buffers);
+
+        // Queue must not be full. Requests are sent to kernel in batches by Submit or Wait
+        void Read(const TDirectIoFile& file, char* dst, size_t count, off_t offset, ui64 cookie, int fixedBufIdx = -1);
+        void Write(TDirectIoFile& file, const char* src, size_t count, off_t offset, ui64 cookie, int fixedBufIdx = -1);
+
+        // iov must be alive till completion
+        void ReadV(const TDirectIoFile& file, const iovec* iov, size_t count, off_t offset, ui64 cookie);
+
+        void Submit();
+
+        // Submit queued requests and wait for at least minCount completions
+        size_t Wait(size_t minCount, std::vector<TCompletion>& completions);
+
+    private:
+        const size_t Depth_ = 0;
+        size_t InFlight_ = 0;
+        std::unique_ptr<TIoUring> Ring_;
+        std::vector<TCompletion> Ready_; // sync fallback
+    };
+
 }
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include "epoch.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace NJK {
+
+    namespace {
+        constexpr size_t CollectPeriod = 64; // retires between Collect() calls
+
+        struct TRetired {
+            void* Ptr = nullptr;
+            void (*Deleter)(void*) = nullptr;
+            size_t Epoch = 0;
+        };
+
+        struct alignas(64) TThreadRecord {
+            // 0 if outside of critical section, (epoch << 1) | 1 otherwise
+            std::atomic<size_t> State{0};
+            std::atomic<bool> InUse{false};
+            TThreadRecord* Next = nullptr; // immutable after publication
+
+            // Owner only
+            size_t Nesting = 0;
+            size_t SinceCollect = 0;
+            std::vector<TRetired> Limbo;
+        };
+
+        std::atomic<size_t> GlobalEpoch{1};
+        std::atomic<TThreadRecord*> Records{nullptr}; // never shrinks, records are reused
+
+        // Garbage of exited threads
+        struct TOrphans {
+            ~TOrphans() {
+                // Process exit, nobody reads anymore
+                for (auto& r : Items) {
+                    r.Deleter(r.Ptr);
+                }
+            }
+
+            std::mutex Lock;
+            std::vector<TRetired> Items;
+        };
+        TOrphans Orphans;
+
+        TThreadRecord* AcquireRecord() {
+            for (auto* r = Records.load(std::memory_order::acquire); r; r = r->Next) {
+                bool expected = false;
+                if (!r->InUse.load(std::memory_order::relaxed)
+                    && r->InUse.compare_exchange_strong(expected, true, std::memory_order::acquire))
+                {
+                    return r;
+                }
+            }
+            auto* r = new TThreadRecord;
+            r->InUse.store(true, std::memory_order::relaxed);
+            r->Next = Records.load(std::memory_order::relaxed);
+            while (!Records.compare_exchange_weak(r->Next, r, std::memory_order::release, std::memory_order::relaxed)) {
+            }
+            return r;
+        }
+
+        struct TLocalRecord {
+            TLocalRecord()
+                : Record(AcquireRecord())
+            {
+            }
+
+            ~TLocalRecord() {
+                if (!Record->Limbo.empty()) {
+                    std::unique_lock g(Orphans.Lock);
+                    Orphans.Items.insert(Orphans.Items.end(), Record->Limbo.begin(), Record->Limbo.end());
+                    Record->Limbo.clear();
+                }
+                Record->InUse.store(false, std::memory_order::release);
+            }
+
+            TThreadRecord* Record;
+        };
+
+        TThreadRecord& LocalRecord() {
+            static thread_local TLocalRecord local;
+            return *local.Record;
+        }
+
+        bool TryAdvance() {
+            size_t epoch = GlobalEpoch.load(std::memory_order::relaxed);
+            std::atomic_thread_fence(std::memory_order::seq_cst);
+            for (auto* r = Records.load(std::memory_order::acquire); r; r = r->Next) {
+                // Acquire: everything the thread did before Leave() happens before advance
+                const size_t state = r->State.load(std::memory_order::acquire);
+                if ((state & 1) && (state >> 1) != epoch) {
+                    return false;
+                }
+            }
+            return GlobalEpoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order::acq_rel);
+        }
+
+        // Frees items retired at least two epochs ago, keeps the rest
+        void FreeExpired(std::vector<TRetired>& items, size_t epoch) {
+            size_t kept = 0;
+            for (auto& r : items) {
+                if (r.Epoch + 2 <= epoch) {
+                    r.Deleter(r.Ptr);
+                } else {
+                    items[kept++] = r;
+                }
+            }
+            items.resize(kept);
+        }
+    }
+
+    void TEpoch::Enter() {
+        auto& r = LocalRecord();
+        if (r.Nesting++ == 0) {
+            r.State.store((GlobalEpoch.load(std::memory_order::relaxed) << 1) | 1, std::memory_order::release);
+            // Announcement must be visible before we read any shared pointer
+            std::atomic_thread_fence(std::memory_order::seq_cst);
+        }
+    }
+
+    void TEpoch::Leave() {
+        auto& r = LocalRecord();
+        if (--r.Nesting == 0) {
+            r.State.store(0, std::memory_order::release);
+        }
+    }
+
+    void TEpoch::RetireImpl(void* ptr, void (*deleter)(void*)) {
+        auto& r = LocalRecord();
+        // Unlink must be ordered before epoch stamp: whoever enters a later
+        // epoch can't reach ptr anymore
+        std::atomic_thread_fence(std::memory_order::seq_cst);
+        r.Limbo.push_back({ptr, deleter, GlobalEpoch.load(std::memory_order::relaxed)});
+        if (++r.SinceCollect >= CollectPeriod) {
+            r.SinceCollect = 0;
+            Collect();
+        }
+    }
+
+    void TEpoch::Collect() {
+        auto& r = LocalRecord();
+        TryAdvance();
+        const size_t epoch = GlobalEpoch.load(std::memory_order::acquire);
+        FreeExpired(r.Limbo, epoch);
+
+        std::unique_lock g(Orphans.Lock, std::try_to_lock);
+        if (g) {
+            FreeExpired(Orphans.Items, epoch);
+        }
+    }
+
+    size_t TEpoch::GetPendingCount() {
+        size_t ret = LocalRecord().Limbo.size();
+        std::unique_lock g(Orphans.Lock);
+        return ret + Orphans.Items.size();
+    }
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+
+namespace NJK {
+
+    // Epoch-based memory reclamation for lock-free structures
+    //
+    // Readers wrap every access to shared nodes into TEpochGuard. Writer
+    // unlinks node and Retire()s it, node is deleted when global epoch has
+    // advanced twice since then: by that moment nobody who could see it is
+    // inside a critical section anymore. Epoch advances only when all threads
+    // inside critical sections have observed the current one.
+    class TEpoch {
+    public:
+        static void Enter();
+        static void Leave();
+
+        // Must be called inside critical section or with node already unreachable
+        template <typename T>
+        static void Retire(T* ptr) {
+            RetireImpl(ptr, [](void* p) {
+                delete static_cast<T*>(p);
+            });
+        }
+
+        // Tries to advance epoch and frees what is safe to free. Retire()
+        // calls it periodically, explicit calls are for tests and idle time
+        static void Collect();
+
+        // Retired by calling thread (and exited ones) but not freed yet
+        static size_t GetPendingCount();
+
+    private:
+        static void RetireImpl(void* ptr, void (*deleter)(void*));
+    };
+
+    class TEpochGuard {
+    public:
+        TEpochGuard() {
+            TEpoch::Enter();
+        }
+
+        ~TEpochGuard() {
+            TEpoch::Leave();
+        }
+
+        TEpochGuard(const TEpochGuard&) = delete;
+        TEpochGuard& operator= (const TEpochGuard&) = delete;
+    };
+
+}
@@ -1,25 +1,43 @@
 #pragma once
 
-#include "lock.h"
+#include "common.h"
+#include "epoch.h"
 
-#include <unordered_map>
-#include <shared_mutex>
-#include <list>
 #include <atomic>
-#include <vector>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <thread>
 
 namespace NJK {
 
-    extern const std::size_t HashTablePrimes[];
-
-    template <typename K, typename T, typename Hash = std::hash<K>, typename L = TNaiveSpinLock>
+    // Concurrent hash map with lock-free lookups
+    //
+    // Split-ordered list (Shalev, Shavit): all items are in one lock-free
+    // list sorted by bit-reversed hash, bucket is a pointer to dummy node
+    // in this list. So doubling bucket count moves nothing: new bucket is
+    // initialized lazily by the first lookup that needs it, by inserting
+    // its dummy into the parent bucket's part of the list. Bucket array
+    // grows by segments and is never reallocated. Dummies live right in
+    // the segments, so lookup goes from bucket straight to its items.
+    //
+    // TValuePtr counts references, item can be erased only when there are
+    // none: eraser swaps RefCount from 0 to Dead, then marks item's Next
+    // (Harris) and it's unlinked by whoever walks by. Unlinked items are
+    // freed through TEpoch, all list walks are inside TEpochGuard.
+    //
+    // If Hash::is_transparent is defined, Find and emplace_key accept any
+    // key type it can hash and TKey can be compared with (and, for
+    // emplace_key, constructed from), like std::unordered_map since C++20.
+    template <typename K, typename T, typename Hash = std::hash<K>>
     class THashMap {
     private:
+        struct TNode;
         struct TKeyValue;
 
     public:
         using TKey = K;
-        using TLock = L;
 
         class TValuePtr {
         public:
@@ -70,25 +88,49 @@ namespace NJK {
                 std::swap(Ptr_, other.Ptr_);
             }
 
+            // One more reference to the same item, it can't be erased meanwhile
+            TValuePtr Share() const {
+                if (Ptr_) {
+                    ++Ptr_->RefCount;
+                }
+                return TValuePtr{Ptr_};
+            }
+
         private:
             TKeyValue* Ptr_ = nullptr;
         };
 
         THashMap() {
-            std::unique_lock g(ResizeLock_);
-            Resize(HashTablePrimes[CapacityIdx_]);
+            GetBucketRef(0).State.store(TBucket::Linked, std::memory_order::release);
         }
 
-        size_t bucket_count() {
-            std::shared_lock g(ResizeLock_);
-            return Buckets_.size();
+        ~THashMap() {
+            // Erased but not yet unlinked nodes are still here, unlinked ones are in TEpoch
+            TNode* node = &GetBucketRef(0).Dummy;
+            while (node) {
+                TNode* next = Unmark(node->Next.load(std::memory_order::relaxed));
+                if (!node->IsDummy()) {
+                    delete static_cast<TKeyValue*>(node);
+                }
+                node = next;
+            }
+            for (auto& segment : Segments_) {
+                ::operator delete[](segment.load(std::memory_order::relaxed), std::align_val_t{alignof(TBucket)});
+            }
+        }
+
+        THashMap(const THashMap&) = delete;
+        THashMap& operator= (const THashMap&) = delete;
+
+        size_t bucket_count() const {
+            return BucketCount_.load(std::memory_order::relaxed);
         }
 
         size_t size() const {
             return Size_.load(std::memory_order::relaxed);
         }
 
-        float load_factor() {
+        float load_factor() const {
             return size() * 1.0 / bucket_count();
         }
 
@@ -101,6 +143,11 @@ namespace NJK {
             return Lookup(key, false).Obj;
         }
 
+        template <typename U, typename H = Hash, typename = typename H::is_transparent>
+        TValuePtr Find(const U& key) {
+            return Lookup(key, false).Obj;
+        }
+
         TValuePtr operator[] (const TKey& key) {
             return Lookup(key, true).Obj;
         }
@@ -109,114 +156,331 @@ namespace NJK {
             return Lookup(key, true);
         }
 
-    private:
-        TLookupResult Lookup(const TKey& key, bool create);
+        // TKey is constructed from key only if there is no such item yet
+        template <typename U, typename H = Hash, typename = typename H::is_transparent>
+        TLookupResult emplace_key(const U& key) {
+            return Lookup(key, true);
+        }
+
+        // Erases item if nobody holds TValuePtr to it
+        bool Erase(const TKey& key) {
+            return TryEvict(key, [](T&) {
+                return true;
+            });
+        }
 
-        void Resize(size_t size);
+        // Same as Erase, but also canEvict(value) must agree. Lookups of
+        // the key wait while it runs, so it must be short and must not
+        // touch the map.
+        template <typename F>
+        bool TryEvict(const TKey& key, F&& canEvict);
+
+        // Items inserted or erased concurrently may be skipped or not
+        template <typename F>
+        void Iterate(F&& f) {
+            TEpochGuard guard;
+            TNode* node = &GetBucketRef(0).Dummy;
+            while (node) {
+                TNode* next = node->Next.load(std::memory_order::acquire);
+                if (!node->IsDummy() && !IsMarked(next)) {
+                    auto* kv = static_cast<TKeyValue*>(node);
+                    f(kv->Key, kv->Value);
+                }
+                node = Unmark(next);
+            }
+        }
 
     private:
-        struct TKeyValue {
-            TKeyValue() = default;
+        template <typename U>
+        TLookupResult Lookup(const U& key, bool create);
+
+        // Increments RefCount unless item is being erased
+        static bool TryAcquire(TKeyValue* kv) {
+            size_t refs = kv->RefCount.load(std::memory_order::relaxed);
+            do {
+                if (refs & Dead) {
+                    return false;
+                }
+            } while (!kv->RefCount.compare_exchange_weak(refs, refs + 1, std::memory_order::acquire, std::memory_order::relaxed));
+            return true;
+        }
 
-            template <typename U>
-            TKeyValue(U&& key)
-                : Key(std::forward<U>(key))
+        // Low bit of Next means that node is erased
+        static bool IsMarked(TNode* p) {
+            return reinterpret_cast<uintptr_t>(p) & 1;
+        }
+
+        static TNode* Mark(TNode* p) {
+            return reinterpret_cast<TNode*>(reinterpret_cast<uintptr_t>(p) | 1);
+        }
+
+        static TNode* Unmark(TNode* p) {
+            return reinterpret_cast<TNode*>(reinterpret_cast<uintptr_t>(p) & ~uintptr_t(1));
+        }
+
+        struct TBucket;
+
+        // Dummy node of bucket, initializes bucket (and its parents) if needed
+        TNode* GetBucket(size_t bucket);
+        TBucket& GetBucketRef(size_t bucket);
+
+        // Returns first node with SoKey == soKey satisfying match, otherwise
+        // prev is the last node with SoKey <= soKey and cur is the next one.
+        // Unlinks erased nodes on the way.
+        template <typename F>
+        static TNode* Search(TNode* start, size_t soKey, F&& match, TNode*& prev, TNode*& cur);
+
+        static size_t ReverseBits(size_t x) {
+            static_assert(sizeof(size_t) == 8);
+            x = ((x >> 1) & 0x5555555555555555ull) | ((x & 0x5555555555555555ull) << 1);
+            x = ((x >> 2) & 0x3333333333333333ull) | ((x & 0x3333333333333333ull) << 2);
+            x = ((x >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((x & 0x0F0F0F0F0F0F0F0Full) << 4);
+            return __builtin_bswap64(x);
+        }
+
+        // Regular keys are odd and dummy ones are even, so dummy of bucket
+        // precedes all its items in the list
+        static size_t RegularKey(size_t hash) {
+            return ReverseBits(hash | (size_t(1) << 63));
+        }
+
+        static size_t DummyKey(size_t bucket) {
+            return ReverseBits(bucket);
+        }
+
+    private:
+        struct TNode {
+            explicit TNode(size_t soKey)
+                : SoKey(soKey)
             {
             }
 
-            template <typename U, typename V>
-            TKeyValue(U&& key, V&& value)
-                : Key(std::forward<U>(key))
-                , Value(std::forward<V>(value))
+            bool IsDummy() const {
+                return !(SoKey & 1);
+            }
+
+            const size_t SoKey;
+            std::atomic<TNode*> Next{nullptr};
+        };
+
+        struct TKeyValue: TNode {
+            template <typename U>
+            TKeyValue(U&& key, size_t soKey)
+                : TNode(soKey)
+                , Key(std::forward<U>(key))
             {
             }
 
             TKey Key{};
             T Value{};
-            std::atomic<size_t> RefCount{0}; // atomic, because bucket lock is changed on hash table resize
+            std::atomic<size_t> RefCount{0}; // or Dead
         };
 
-        const float MaxLoadFactor_ = 1.0;
-        std::shared_mutex ResizeLock_;
-        //using TKeyValue = std::pair<TKey, TValueWithRefCount>;
+        static constexpr size_t Dead = size_t(1) << 63;
+
         struct TBucket {
-            std::unique_ptr<TLock> Lock;
-            std::list<TKeyValue> Chain;
+            enum EState: ui8 {
+                Empty,
+                Linking,
+                Linked,
+            };
+
+            explicit TBucket(size_t bucket)
+                : Dummy(DummyKey(bucket))
+            {
+            }
+
+            TNode Dummy;
+            std::atomic<ui8> State{Empty}; // of Dummy in the list
         };
-        std::vector<TBucket> Buckets_;
+
+        // Segment 0 is bucket 0, segment s > 0 is buckets [2^(s-1), 2^s)
+        static constexpr size_t MaxSegments = 64;
+        static constexpr size_t InitialBucketCount = 4;
+        const float MaxLoadFactor_ = 1.0;
+
+        std::atomic<TBucket*> Segments_[MaxSegments]{};
+        std::atomic<size_t> BucketCount_{InitialBucketCount};
         std::atomic<size_t> Size_{0};
         Hash Hash_{};
-        size_t CapacityIdx_ = 0;
     };
 
-    template <typename K, typename T, typename Hash, typename L>
-    typename THashMap<K, T, Hash, L>::TLookupResult THashMap<K, T, Hash, L>::Lookup(const TKey& key, bool create) {
-        const auto hash = Hash_(key);
-        float loadFactor = 0;
-        bool created = false;
+    template <typename K, typename T, typename Hash>
+    template <typename U>
+    typename THashMap<K, T, Hash>::TLookupResult THashMap<K, T, Hash>::Lookup(const U& key, bool create) {
+        TEpochGuard guard;
+        const size_t hash = Hash_(key);
+        const size_t soKey = RegularKey(hash);
+        const size_t bucketCount = BucketCount_.load(std::memory_order::acquire);
+        TNode* start = GetBucket(hash & (bucketCount - 1));
+
+        auto match = [&key](TNode* node) {
+            return static_cast<TKeyValue*>(node)->Key == key;
+        };
 
-        TKeyValue* kv = nullptr;
-        {
-            std::shared_lock g(ResizeLock_);
-            auto& bucket = Buckets_[hash % Buckets_.size()];
+        TKeyValue* fresh = nullptr;
+        while (true) {
+            TNode* prev = nullptr;
+            TNode* cur = nullptr;
+            if (TNode* found = Search(start, soKey, match, prev, cur)) {
+                auto* kv = static_cast<TKeyValue*>(found);
+                if (!TryAcquire(kv)) {
+                    // Eviction is in progress, wait till it's either unlinked or kept
+                    std::this_thread::yield();
+                    continue;
+                }
+                delete fresh; // lost the race, nobody has seen it
+                return {TValuePtr{kv}, false};
+            }
+            if (!create) {
+                return {};
+            }
+            if (!fresh) {
+                fresh = new TKeyValue(key, soKey);
+                fresh->RefCount.store(1, std::memory_order::relaxed);
+            }
+            fresh->Next.store(cur, std::memory_order::relaxed);
+            if (prev->Next.compare_exchange_weak(cur, fresh, std::memory_order::release, std::memory_order::relaxed)) {
+                break;
+            }
+        }
 
-            auto g1 = MakeGuard(*bucket.Lock);
+        const size_t size = Size_.fetch_add(1, std::memory_order::relaxed) + 1;
+        size_t buckets = bucketCount;
+        if (size > buckets * MaxLoadFactor_) {
+            // Nothing to move, buckets are split on demand
+            BucketCount_.compare_exchange_strong(buckets, buckets * 2, std::memory_order::release, std::memory_order::relaxed);
+        }
 
-            for (auto& item : bucket.Chain) {
-                if (item.Key == key) {
-                    kv = &item;
-                    break;
-                } 
-            }
+        return {TValuePtr{fresh}, true};
+    }
 
-            if (!kv && create) {
-                kv = &bucket.Chain.emplace_front(key);
-                ++Size_;
-                loadFactor = Size_.load() * 1.0 / Buckets_.size();
-                created = true;
-            }
+    template <typename K, typename T, typename Hash>
+    template <typename F>
+    bool THashMap<K, T, Hash>::TryEvict(const TKey& key, F&& canEvict) {
+        TEpochGuard guard;
+        const size_t hash = Hash_(key);
+        const size_t soKey = RegularKey(hash);
+        TNode* start = GetBucket(hash & (BucketCount_.load(std::memory_order::acquire) - 1));
+
+        TNode* prev = nullptr;
+        TNode* cur = nullptr;
+        TNode* found = Search(start, soKey, [&key](TNode* node) {
+            return static_cast<TKeyValue*>(node)->Key == key;
+        }, prev, cur);
+        if (!found) {
+            return false;
+        }
 
-            if (kv) {
-                ++kv->RefCount;
-            }
+        auto* kv = static_cast<TKeyValue*>(found);
+        size_t refs = 0;
+        if (!kv->RefCount.compare_exchange_strong(refs, Dead, std::memory_order::acquire, std::memory_order::relaxed)) {
+            return false;
+        }
+        if (!canEvict(kv->Value)) {
+            kv->RefCount.store(0, std::memory_order::release);
+            return false;
         }
 
-        if (!kv && !create) {
-            return TLookupResult{TValuePtr{}, false};
+        // Nobody can link after marked node, so it's frozen in the list
+        TNode* next = kv->Next.load(std::memory_order::relaxed);
+        while (!kv->Next.compare_exchange_weak(next, Mark(next), std::memory_order::acq_rel, std::memory_order::relaxed)) {
         }
+        Size_.fetch_sub(1, std::memory_order::relaxed);
 
-        if (loadFactor > MaxLoadFactor_) {
-            std::unique_lock g(ResizeLock_);
-            loadFactor = Size_.load() * 1.0 / Buckets_.size();
-            if (loadFactor > MaxLoadFactor_) {
-                Resize(HashTablePrimes[++CapacityIdx_]);
+        // Unlink now, not by the next walker
+        Search(start, soKey, [](TNode*) {
+            return false;
+        }, prev, cur);
+        return true;
+    }
+
+    template <typename K, typename T, typename Hash>
+    template <typename F>
+    typename THashMap<K, T, Hash>::TNode* THashMap<K, T, Hash>::Search(TNode* start, size_t soKey, F&& match, TNode*& prev, TNode*& cur) {
+    retry:
+        prev = start; // dummy, is never erased
+        cur = Unmark(prev->Next.load(std::memory_order::acquire));
+        while (cur) {
+            TNode* next = cur->Next.load(std::memory_order::acquire);
+            if (IsMarked(next)) {
+                TNode* expected = cur;
+                if (!prev->Next.compare_exchange_strong(expected, Unmark(next), std::memory_order::acq_rel, std::memory_order::relaxed)) {
+                    // prev is erased or something was inserted before cur
+                    goto retry;
+                }
+                // Only regular nodes are erased
+                TEpoch::Retire(static_cast<TKeyValue*>(cur));
+                cur = Unmark(next);
+                continue;
+            }
+            if (cur->SoKey > soKey) {
+                break;
+            }
+            if (cur->SoKey == soKey && match(cur)) {
+                return cur;
             }
+            prev = cur;
+            cur = next;
         }
-
-        return {TValuePtr{kv}, created};
+        return nullptr;
     }
 
-    template <typename K, typename T, typename Hash, typename L>
-    void THashMap<K, T, Hash, L>::Resize(size_t size) {
-        std::vector<TBucket> newBuckets;
-        newBuckets.resize(size);
+    // Called inside TEpochGuard
+    template <typename K, typename T, typename Hash>
+    typename THashMap<K, T, Hash>::TNode* THashMap<K, T, Hash>::GetBucket(size_t bucket) {
+        TBucket& ref = GetBucketRef(bucket);
+        if (ref.State.load(std::memory_order::acquire) == TBucket::Linked) {
+            return &ref.Dummy;
+        }
+
+        // Parent is bucket without highest bit, it's split by this one
+        TNode* start = GetBucket(bucket & ~std::bit_floor(bucket));
 
-        for (auto& oldBucket : Buckets_) {
-            auto& oldChain = oldBucket.Chain;
-            for (auto it = oldChain.begin(); it != oldChain.end();) {
-                auto next = it;
-                ++next;
-                const auto hash = Hash_(it->Key);
-                auto& newBucket = newBuckets[hash % newBuckets.size()];
-                newBucket.Chain.splice(newBucket.Chain.begin(), oldChain, it);
-                it = next;
+        // There is only one dummy per bucket, so only one thread may link it
+        ui8 state = TBucket::Empty;
+        if (!ref.State.compare_exchange_strong(state, TBucket::Linking, std::memory_order::acquire)) {
+            // Once per bucket and short, not worth helping
+            while (ref.State.load(std::memory_order::acquire) != TBucket::Linked) {
+                std::this_thread::yield();
             }
+            return &ref.Dummy;
         }
-        for (auto& bucket : newBuckets) {
-            bucket.Lock.reset(new TLock());
+
+        TNode* dummy = &ref.Dummy;
+        while (true) {
+            TNode* prev = nullptr;
+            TNode* cur = nullptr;
+            Search(start, dummy->SoKey, [](TNode*) { return false; }, prev, cur);
+            dummy->Next.store(cur, std::memory_order::relaxed);
+            if (prev->Next.compare_exchange_weak(cur, dummy, std::memory_order::release, std::memory_order::relaxed)) {
+                break;
+            }
         }
 
-        Buckets_.swap(newBuckets);
+        ref.State.store(TBucket::Linked, std::memory_order::release);
+        return dummy;
+    }
+
+    template <typename K, typename T, typename Hash>
+    typename THashMap<K, T, Hash>::TBucket& THashMap<K, T, Hash>::GetBucketRef(size_t bucket) {
+        const size_t segmentIdx = std::bit_width(bucket);
+        const size_t segmentBegin = segmentIdx ? size_t(1) << (segmentIdx - 1) : 0;
+
+        auto* segment = Segments_[segmentIdx].load(std::memory_order::acquire);
+        if (!segment) {
+            const size_t segmentSize = segmentIdx ? segmentBegin : 1;
+            auto* fresh = static_cast<TBucket*>(::operator new[](segmentSize * sizeof(TBucket), std::align_val_t{alignof(TBucket)}));
+            for (size_t i = 0; i < segmentSize; ++i) {
+                new (fresh + i) TBucket(segmentBegin + i);
+            }
+            if (Segments_[segmentIdx].compare_exchange_strong(segment, fresh, std::memory_order::acq_rel)) {
+                segment = fresh;
+            } else {
+                ::operator delete[](fresh, std::align_val_t{alignof(TBucket)});
+            }
+        }
+        return segment[bucket - segmentBegin];
     }
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,179 @@
+#include "io_uring.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace NJK {
+
+    namespace {
+        int IoUringSetup(ui32 entries, io_uring_params* params) {
+            return syscall(__NR_io_uring_setup, entries, params);
+        }
+
+        int IoUringEnter(int fd, ui32 toSubmit, ui32 minComplete, ui32 flags) {
+            return syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+        }
+
+        int IoUringRegister(int fd, ui32 opcode, const void* arg, ui32 count) {
+            return syscall(__NR_io_uring_register, fd, opcode, arg, count);
+        }
+
+        void* MapRing(int fd, size_t size, off_t offset) {
+            void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+            if (ptr == MAP_FAILED) {
+                throw std::system_error(errno, std::generic_category(), "io_uring mmap");
+            }
+            return ptr;
+        }
+
+        template <typename T>
+        T* At(void* base, ui32 offset) {
+            return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+        }
+    }
+
+    TIoUring::TIoUring(ui32 entries) {
+        io_uring_params params{};
+        Fd_ = IoUringSetup(entries, &params);
+        Y_SYSCALL(Fd_);
+        Entries_ = params.sq_entries;
+
+        SqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        CqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            SqRingSize_ = CqRingSize_ = std::max(SqRingSize_, CqRingSize_);
+        }
+
+        SqRing_ = MapRing(Fd_, SqRingSize_, IORING_OFF_SQ_RING);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            CqRing_ = SqRing_;
+        } else {
+            CqRing_ = MapRing(Fd_, CqRingSize_, IORING_OFF_CQ_RING);
+        }
+        SqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+        Sqes_ = static_cast<io_uring_sqe*>(MapRing(Fd_, SqesSize_, IORING_OFF_SQES));
+
+        SqHead_ = At<unsigned>(SqRing_, params.sq_off.head);
+        SqTail_ = At<unsigned>(SqRing_, params.sq_off.tail);
+        SqArray_ = At<unsigned>(SqRing_, params.sq_off.array);
+        SqMask_ = *At<unsigned>(SqRing_, params.sq_off.ring_mask);
+        SqLocalTail_ = SqSubmitted_ = *SqTail_;
+
+        CqHead_ = At<unsigned>(CqRing_, params.cq_off.head);
+        CqTail_ = At<unsigned>(CqRing_, params.cq_off.tail);
+        Cqes_ = At<io_uring_cqe>(CqRing_, params.cq_off.cqes);
+        CqMask_ = *At<unsigned>(CqRing_, params.cq_off.ring_mask);
+    }
+
+    TIoUring::~TIoUring() {
+        munmap(Sqes_, SqesSize_);
+        if (CqRing_ != SqRing_) {
+            munmap(CqRing_, CqRingSize_);
+        }
+        munmap(SqRing_, SqRingSize_);
+        close(Fd_);
+    }
+
+    bool TIoUring::IsSupported() {
+        static const bool supported = [] {
+            io_uring_params params{};
+            const int fd = IoUringSetup(1, &params);
+            if (fd == -1) {
+                return false;
+            }
+            close(fd);
+            return true;
+        }();
+        return supported;
+    }
+
+    bool TIoUring::RegisterBuffers(const std::vector<iovec>& buffers) {
+        return IoUringRegister(Fd_, IORING_REGISTER_BUFFERS, buffers.data(), buffers.size()) == 0;
+    }
+
+    io_uring_sqe* TIoUring::NextSqe() {
+        const unsigned head = std::atomic_ref<unsigned>(*SqHead_).load(std::memory_order::acquire);
+        if (SqLocalTail_ - head >= Entries_) {
+            return nullptr;
+        }
+        const unsigned idx = SqLocalTail_ & SqMask_;
+        io_uring_sqe* sqe = &Sqes_[idx];
+        std::memset(sqe, 0, sizeof(*sqe));
+        SqArray_[idx] = idx;
+        ++SqLocalTail_;
+        return sqe;
+    }
+
+    bool TIoUring::PrepareRead(int fd, char* buf, size_t count, off_t offset, ui64 userData, int fixedBufIdx) {
+        io_uring_sqe* sqe = NextSqe();
+        if (!sqe) {
+            return false;
+        }
+        sqe->opcode = fixedBufIdx == -1 ? IORING_OP_READ : IORING_OP_READ_FIXED;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<ui64>(buf);
+        sqe->len = count;
+        sqe->off = offset;
+        sqe->user_data = userData;
+        if (fixedBufIdx != -1) {
+            sqe->buf_index = fixedBufIdx;
+        }
+        return true;
+    }
+
+    bool TIoUring::PrepareWrite(int fd, const char* buf, size_t count, off_t offset, ui64 userData, int fixedBufIdx) {
+        io_uring_sqe* sqe = NextSqe();
+        if (!sqe) {
+            return false;
+        }
+        sqe->opcode = fixedBufIdx == -1 ? IORING_OP_WRITE : IORING_OP_WRITE_FIXED;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<ui64>(buf);
+        sqe->len = count;
+        sqe->off = offset;
+        sqe->user_data = userData;
+        if (fixedBufIdx != -1) {
+            sqe->buf_index = fixedBufIdx;
+        }
+        return true;
+    }
+
+    bool TIoUring::PrepareReadV(int fd, const iovec* iov, size_t count, off_t offset, ui64 userData) {
+        io_uring_sqe* sqe = NextSqe();
+        if (!sqe) {
+            return false;
+        }
+        sqe->opcode = IORING_OP_READV;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<ui64>(iov);
+        sqe->len = count;
+        sqe->off = offset;
+        sqe->user_data = userData;
+        return true;
+    }
+
+    size_t TIoUring::Submit(size_t minComplete) {
+        const unsigned toSubmit = SqLocalTail_ - SqSubmitted_;
+        std::atomic_ref<unsigned>(*SqTail_).store(SqLocalTail_, std::memory_order::release);
+
+        if (!toSubmit && !minComplete) {
+            return 0;
+        }
+
+        const ui32 flags = minComplete ? IORING_ENTER_GETEVENTS : 0;
+        while (true) {
+            const int ret = IoUringEnter(Fd_, toSubmit, minComplete, flags);
+            if (ret == -1 && errno == EINTR) {
+                continue;
+            }
+            Y_SYSCALL(ret);
+            SqSubmitted_ += ret;
+            return ret;
+        }
+    }
+
+}
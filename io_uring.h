@@ -0,0 +1,82 @@
+#pragma once
+
+#include "common.h"
+
+#include <atomic>
+#include <vector>
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+
+namespace NJK {
+
+    // Minimal io_uring over raw syscalls (no liburing dependency)
+    // Not thread-safe, use one ring per thread
+    class TIoUring {
+    public:
+        explicit TIoUring(ui32 entries);
+        ~TIoUring();
+
+        TIoUring(const TIoUring&) = delete;
+        TIoUring& operator= (const TIoUring&) = delete;
+
+        static bool IsSupported();
+
+        // All at once, returns false if kernel refused (RLIMIT_MEMLOCK for example)
+        bool RegisterBuffers(const std::vector<iovec>& buffers);
+
+        // Return false if submission queue is full
+        bool PrepareRead(int fd, char* buf, size_t count, off_t offset, ui64 userData, int fixedBufIdx = -1);
+        bool PrepareWrite(int fd, const char* buf, size_t count, off_t offset, ui64 userData, int fixedBufIdx = -1);
+        bool PrepareReadV(int fd, const iovec* iov, size_t count, off_t offset, ui64 userData);
+
+        // Submit prepared entries and wait for at least minComplete completions
+        size_t Submit(size_t minComplete = 0);
+
+        // Calls onComplete(userData, result) for each ready completion
+        template <typename F>
+        size_t Reap(F&& onComplete) {
+            std::atomic_ref<unsigned> tailRef(*CqTail_);
+            std::atomic_ref<unsigned> headRef(*CqHead_);
+            unsigned head = headRef.load(std::memory_order::relaxed);
+            const unsigned tail = tailRef.load(std::memory_order::acquire);
+            size_t count = 0;
+            for (; head != tail; ++head, ++count) {
+                const io_uring_cqe& cqe = Cqes_[head & CqMask_];
+                onComplete(static_cast<ui64>(cqe.user_data), cqe.res);
+            }
+            headRef.store(head, std::memory_order::release);
+            return count;
+        }
+
+        ui32 GetEntries() const {
+            return Entries_;
+        }
+
+    private:
+        io_uring_sqe* NextSqe();
+
+    private:
+        int Fd_ = -1;
+        ui32 Entries_ = 0;
+
+        void* SqRing_ = nullptr;
+        size_t SqRingSize_ = 0;
+        void* CqRing_ = nullptr;
+        size_t CqRingSize_ = 0;
+        io_uring_sqe* Sqes_ = nullptr;
+        size_t SqesSize_ = 0;
+
+        unsigned* SqHead_ = nullptr;
+        unsigned* SqTail_ = nullptr;
+        unsigned* SqArray_ = nullptr;
+        unsigned SqMask_ = 0;
+        unsigned SqLocalTail_ = 0;
+        unsigned SqSubmitted_ = 0;
+
+        unsigned* CqHead_ = nullptr;
+        unsigned* CqTail_ = nullptr;
+        io_uring_cqe* Cqes_ = nullptr;
+        unsigned CqMask_ = 0;
+    };
+
+}
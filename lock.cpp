@@ -2,6 +2,42 @@
 
 namespace NJK {
 
+    Y_NO_INLINE
+    void TAdaptiveLock::LockSlow() {
+        size_t pauses = 1;
+        for (size_t spent = 0; spent < MaxSpinPauses; spent += pauses, pauses *= 2) {
+            for (size_t i = 0; i < pauses; ++i) {
+                SpinPause();
+            }
+            // Don't bounce cache line with CAS while it's locked
+            int state = State_.load(std::memory_order::relaxed);
+            if (state == Unlocked
+                && State_.compare_exchange_weak(state, Locked, std::memory_order::acquire, std::memory_order::relaxed))
+            {
+                return;
+            }
+            if (state == Contended) {
+                break; // others are sleeping already, don't overtake them for long
+            }
+        }
+
+        // Whoever takes the lock from here on doesn't know whether there are
+        // other sleepers, so marks it Contended to make unlock() wake next one
+        while (State_.exchange(Contended, std::memory_order::acquire) != Unlocked) {
+            FutexWait();
+        }
+    }
+
+    Y_NO_INLINE
+    void TAdaptiveLock::FutexWait() {
+        syscall(SYS_futex, Word(), FUTEX_WAIT_PRIVATE, Contended, nullptr, nullptr, 0);
+    }
+
+    Y_NO_INLINE
+    void TAdaptiveLock::FutexWake() {
+        syscall(SYS_futex, Word(), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+
     Y_NO_INLINE
     void TCondVar::FutexWait(int val) {
         syscall(SYS_futex, Word(), FUTEX_WAIT, val, nullptr, nullptr, 0);
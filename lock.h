@@ -11,16 +11,29 @@
 
 namespace NJK {
 
+    // Hint for CPU (and sibling hyperthread) that we are spinning
+    inline void SpinPause() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
     class TNaiveSpinLock {
     public:
         void lock() {
             while (Value_.test_and_set(std::memory_order::acquire)) {
-                //while (Value_.test(std::memory_order::relaxed)) {
-                    // TODO pause
-                //}
+                while (Value_.test(std::memory_order::relaxed)) {
+                    SpinPause();
+                }
             }
         }
 
+        bool try_lock() {
+            return !Value_.test_and_set(std::memory_order::acquire);
+        }
+
         void unlock() {
             Value_.clear(std::memory_order::release);
         }
@@ -29,6 +42,50 @@ namespace NJK {
         std::atomic_flag Value_;
     };
 
+    // Spins a bit (test-and-test-and-set with exponential backoff), then
+    // sleeps on futex. Good for short critical sections under
+    // oversubscription, where TNaiveSpinLock burns whole time slices
+    // spinning on the lock of preempted owner.
+    class TAdaptiveLock {
+    public:
+        void lock() {
+            int expected = Unlocked;
+            if (!State_.compare_exchange_weak(expected, Locked, std::memory_order::acquire, std::memory_order::relaxed)) {
+                LockSlow();
+            }
+        }
+
+        bool try_lock() {
+            int expected = Unlocked;
+            return State_.compare_exchange_strong(expected, Locked, std::memory_order::acquire, std::memory_order::relaxed);
+        }
+
+        void unlock() {
+            if (State_.exchange(Unlocked, std::memory_order::release) == Contended) {
+                FutexWake();
+            }
+        }
+
+    private:
+        void LockSlow();
+        void FutexWait();
+        void FutexWake();
+
+        int* Word() {
+            static_assert(sizeof(int) == sizeof(State_));
+            return reinterpret_cast<int*>(&State_);
+        }
+
+    private:
+        static constexpr int Unlocked = 0;
+        static constexpr int Locked = 1;
+        static constexpr int Contended = 2; // somebody may sleep in futex
+
+        static constexpr size_t MaxSpinPauses = 1024; // in total, with backoff
+
+        std::atomic<int> State_{Unlocked};
+    };
+
     template <typename T>
     class TLockGuard {
     public:
@@ -112,8 +169,8 @@ namespace NJK {
         void FutexWake(int count);
 
     private:
-        std::atomic<int> Iter_;
-        std::atomic<size_t> Waiting_;
+        std::atomic<int> Iter_{0};
+        std::atomic<int> Waiting_{0};
     };
 
 }
\ No newline at end of file
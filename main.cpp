@@ -2,9 +2,11 @@
 #include "volume.h"
 #include "volume/ops.h"
 #include "volume/block_group.h"
+#include "volume/meta_group.h"
 #include "storage.h"
 #include "fixed_buffer.h"
 #include "hash_map.h"
+#include "epoch.h"
 #include "bitset.h"
 
 //#include <benchmark/benchmark.h>
@@ -12,11 +14,17 @@
 #include <cassert>
 #include <iostream>
 #include <sstream>
+#include <mutex>
 #include <shared_mutex>
 #include <condition_variable>
 #include <filesystem>
 #include <unordered_map>
 #include <thread>
+#include <random>
+#include <numeric>
+#include <bit>
+#include <csignal>
+#include <sys/resource.h>
 
 using NJK::NVolume::TInodeDataOps;
 using NJK::NVolume::TInodeValue;
@@ -71,9 +79,38 @@ void TestSuperBlockSerialization() {
     CMP(BlockGroupDescriptorsBlockCount);
     CMP(MetaGroupCount); // File count
     CMP(MaxFileSize);
+    CMP(FormatVersion);
 #undef CMP
 }
 
+void TestVolumeFormatVersion() {
+    using namespace NJK;
+
+    const std::string volumePath = "./var/volume_format_version";
+    std::filesystem::remove_all(volumePath);
+    {
+        TVolume vol(volumePath, {}, false);
+    }
+    assert(TVolume(volumePath, {}, false).GetSuperBlock().FormatVersion == TVolume::TSuperBlock::CurrentFormatVersion);
+
+    // Image of previous version, it has other inode layout
+    {
+        TVolume::TSettings settings;
+        TBlockDirectIoFile f(volumePath + "/super_block", settings.BlockSize);
+        auto buf = TFixedBuffer::Aligned(settings.BlockSize);
+        f.ReadBlock(buf, 0);
+        std::memset(buf.MutableData() + TVolume::TSuperBlock::OnDiskSize - sizeof(ui32), 0, sizeof(ui32));
+        f.WriteBlock(buf, 0);
+    }
+    bool thrown = false;
+    try {
+        TVolume vol(volumePath, {}, false);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
 template <typename T>
 void CheckOnDiskSize() {
     using namespace NJK;
@@ -90,6 +127,38 @@ void CheckOnDiskSize() {
     DeserializeChecked(in, dst);
 }
 
+// Free count of block group which doesn't match its bitmap makes the scan fail
+void TestMetaGroupFailedScan() {
+    using namespace NJK;
+
+    const std::string filePath = "./var/meta_group_failed_scan";
+    std::filesystem::create_directories("./var");
+    std::filesystem::remove(filePath);
+
+    const auto sb = TVolume::CalcSuperBlock({});
+    {
+        NVolume::TMetaGroup mg(filePath, 0, sb);
+        for (size_t i = 0; i <= sb.BlockGroupDataBlockCount; ++i) {
+            assert(mg.TryAllocateDataBlock() != -1);
+        }
+        mg.DeallocateDataBlock(5);
+    }
+    {
+        TBlockDirectIoFile raw(filePath, sb.BlockSize);
+        auto buf = TFixedBuffer::Aligned(sb.BlockSize);
+        const size_t bitmapIdx = sb.ZeroBlockGroupOffset / sb.BlockSize + NVolume::TBlockGroup::DataBlocksBitmapBlockIndex;
+        raw.ReadBlock(buf, bitmapIdx);
+        buf.MutableData()[0] |= 1 << 5;
+        raw.WriteBlock(buf, bitmapIdx);
+    }
+    {
+        NVolume::TMetaGroup mg(filePath, 0, sb);
+        // Owner's block group has "free" block, but it's taken
+        const i32 id = mg.TryAllocateDataBlock(TVolume::TInode{.Id = 0});
+        assert(id != -1 && (ui32)id > sb.BlockGroupDataBlockCount);
+    }
+}
+
 void TestInodeAllocation() {
     using namespace NJK;
 
@@ -219,6 +288,475 @@ void TestDataBlockAllocation() {
     }
 }
 
+void TestBlockCacheEviction() {
+    using namespace NJK;
+
+    const std::string volumePath = "./var/volume_cache_eviction";
+    std::filesystem::remove_all(volumePath);
+
+    TVolume::TSettings settings;
+    settings.BlockCacheSize = 64 * settings.BlockSize;
+
+    const size_t blockCount = 1000;
+    {
+        TVolume vol(volumePath, settings, false);
+
+        auto pinned = vol.GetMutableDataBlock(vol.AllocateDataBlock());
+        pinned.Buf().MutableData()[0] = 77;
+
+        for (size_t i = 1; i < blockCount; ++i) {
+            auto blockId = vol.AllocateDataBlock();
+            assert(blockId == i);
+            auto block = vol.GetMutableDataBlock(blockId);
+            block.Buf().MutableData()[0] = i % 128;
+            block.Buf().MutableData()[100] = i % 100;
+        }
+
+        // dirty blocks must survive eviction
+        for (size_t i = 1; i < blockCount; ++i) {
+            auto block = vol.GetDataBlock(i);
+            assert(block.Buf().Data()[0] == char(i % 128));
+            assert(block.Buf().Data()[100] == char(i % 100));
+        }
+
+        // pinned block is never evicted
+        assert(pinned.Buf().Data()[0] == 77);
+
+        const auto stats = vol.GetCacheStats();
+        assert(stats.Evictions > 0);
+        assert(stats.FlushedBlocks > 0);
+        assert(stats.Misses >= blockCount);
+    }
+
+    {
+        TVolume vol(volumePath, settings, false);
+        assert(vol.GetDataBlock(0).Buf().Data()[0] == 77);
+        for (size_t i = 1; i < blockCount; ++i) {
+            auto block = vol.GetDataBlock(i);
+            assert(block.Buf().Data()[0] == char(i % 128));
+            assert(block.Buf().Data()[100] == char(i % 100));
+        }
+    }
+}
+
+void TestBlockCacheShards() {
+    using namespace NJK;
+
+    const std::string filePath = "./var/block_cache_shards";
+    std::filesystem::remove(filePath);
+
+    const size_t blockCount = 1024;
+    TBlockDirectIoFile raw(filePath, 4096);
+    raw.TruncateInBlocks(blockCount);
+    {
+        auto buf = TFixedBuffer::Aligned(4096);
+        buf.FillZeroes();
+        for (size_t i = 0; i < blockCount; ++i) {
+            reinterpret_cast<ui32*>(buf.MutableData())[0] = i;
+            raw.WriteBlock(buf, i);
+        }
+    }
+
+    {
+        TCachedBlockFile::TSettings settings;
+        settings.Capacity = 100;
+        settings.Shards = 8;
+        TCachedBlockFile cached(raw, settings);
+        assert(cached.GetShardCount() == 1); // too small to split
+    }
+
+    const size_t threadCount = 8;
+    const size_t opCount = 5000;
+    {
+        TCachedBlockFile::TSettings settings;
+        settings.Capacity = 256;
+        settings.Shards = 4;
+        settings.ReadaheadMax = 0;
+        TCachedBlockFile cached(raw, settings);
+        assert(cached.GetShardCount() == 4);
+
+        // Each thread increments its own counter at offset 4 * (1 + threadIdx)
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < threadCount; ++t) {
+            threads.emplace_back([&cached, t] {
+                std::mt19937 rng(t);
+                std::uniform_int_distribution<size_t> dist(0, blockCount - 1);
+                for (size_t i = 0; i < opCount; ++i) {
+                    const size_t idx = dist(rng);
+                    if (i % 4) {
+                        auto block = cached.GetBlock(idx);
+                        assert(reinterpret_cast<const ui32*>(block.Buf().Data())[0] == idx);
+                    } else {
+                        auto block = cached.GetMutableBlock(idx);
+                        ++reinterpret_cast<ui32*>(block.Buf().MutableData())[1 + t];
+                    }
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+
+        const auto stats = cached.GetStats();
+        assert(stats.Hits + stats.Misses == threadCount * opCount);
+        assert(stats.Evictions > 0);
+        assert(cached.GetResidentCount() <= settings.Capacity + stats.Overflows);
+    }
+
+    size_t total = 0;
+    auto buf = TFixedBuffer::Aligned(4096);
+    for (size_t i = 0; i < blockCount; ++i) {
+        raw.ReadBlock(buf, i);
+        const ui32* data = reinterpret_cast<const ui32*>(buf.Data());
+        assert(data[0] == i);
+        for (size_t t = 0; t < threadCount; ++t) {
+            total += data[1 + t];
+        }
+    }
+    assert(total == threadCount * opCount / 4);
+}
+
+void TestBlockCacheWriteBack() {
+    using namespace NJK;
+
+    const std::string filePath = "./var/cached_block_file";
+    std::filesystem::remove(filePath);
+
+    TBlockDirectIoFile raw(filePath, 4096);
+    raw.TruncateInBlocks(128);
+
+    auto onDisk = [&raw](size_t blockIdx) {
+        auto buf = TFixedBuffer::Aligned(4096);
+        raw.ReadBlock(buf, blockIdx);
+        return buf.Data()[0];
+    };
+
+    TCachedBlockFile::TSettings settings;
+    settings.FlushInterval = std::chrono::milliseconds(10);
+    settings.MaxFlushRun = 32;
+    TCachedBlockFile file(raw, settings);
+
+    for (size_t i = 0; i < 64; ++i) {
+        file.GetMutableBlock(i).Buf().MutableData()[0] = 1;
+    }
+    file.GetMutableBlock(100).Buf().MutableData()[0] = 1;
+    file.Sync();
+
+    for (size_t i = 0; i < 64; ++i) {
+        assert(onDisk(i) == 1);
+    }
+    assert(onDisk(100) == 1);
+
+    // may be also written by flusher in parts
+    const auto stats = file.GetStats();
+    assert(stats.FlushedBlocks == 65);
+    assert(stats.FlushWrites >= 3 && stats.FlushWrites < 10);
+
+    // background write-back without Sync
+    file.GetMutableBlock(7).Buf().MutableData()[0] = 2;
+    for (size_t i = 0; i < 500 && onDisk(7) != 2; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    assert(onDisk(7) == 2);
+
+    // Without flusher writers keep dirty blocks under the limit themselves
+    TCachedBlockFile::TSettings bounded;
+    bounded.Capacity = 64;
+    bounded.Shards = 1;
+    TCachedBlockFile noFlusher(raw, bounded);
+    for (size_t i = 0; i < 128; ++i) {
+        noFlusher.GetMutableBlock(i).Buf().MutableData()[0] = 3;
+    }
+    const auto boundedStats = noFlusher.GetStats();
+    assert(boundedStats.FlushedBlocks >= 128 - 64 * bounded.MaxDirtyRatio - 1);
+    assert(onDisk(0) == 3);
+
+    // Sync waits for block under modification, while its modifier wants
+    // the previous block of the same run
+    TCachedBlockFile file2(raw);
+    file2.GetMutableBlock(4).Buf().MutableData()[0] = 4;
+    std::atomic<bool> held{false};
+    std::thread modifier([&] {
+        auto page5 = file2.GetMutableBlock(5);
+        page5.Buf().MutableData()[0] = 5;
+        held = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        file2.GetMutableBlock(4).Buf().MutableData()[0] = 6;
+    });
+    while (!held) {
+        std::this_thread::yield();
+    }
+    file2.Sync();
+    modifier.join();
+    assert(onDisk(5) == 5);
+    file2.Sync();
+    assert(onDisk(4) == 6);
+}
+
+// Writes past RLIMIT_FSIZE fail with EFBIG
+void TestBlockCacheWriteFailure() {
+    using namespace NJK;
+
+    const std::string filePath = "./var/cached_block_file_failure";
+    std::filesystem::remove(filePath);
+
+    TBlockDirectIoFile raw(filePath, 4096);
+    raw.TruncateInBlocks(16);
+
+    auto onDisk = [&raw](size_t blockIdx) {
+        auto buf = TFixedBuffer::Aligned(4096);
+        raw.ReadBlock(buf, blockIdx);
+        return buf.Data()[0];
+    };
+
+    rlimit old{};
+    assert(getrlimit(RLIMIT_FSIZE, &old) == 0);
+    const auto oldHandler = signal(SIGXFSZ, SIG_IGN);
+
+    TCachedBlockFile::TSettings settings;
+    settings.FlushInterval = std::chrono::milliseconds(1);
+    TCachedBlockFile file(raw, settings);
+
+    rlimit limit = old;
+    limit.rlim_cur = 16 * 4096;
+    assert(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+
+    file.GetMutableBlock(1).Buf().MutableData()[0] = 1;
+    file.GetBlockForOverwrite(20).Buf().MutableData()[0] = 1;
+    // Flusher fails in background, Sync reports it
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    bool thrown = false;
+    try {
+        file.Sync();
+    } catch (const std::exception&) {
+        thrown = true;
+    }
+    assert(thrown);
+    assert(onDisk(1) == 1);
+
+    // Failed block is still dirty
+    assert(setrlimit(RLIMIT_FSIZE, &old) == 0);
+    signal(SIGXFSZ, oldHandler);
+    file.Sync();
+    assert(onDisk(20) == 1);
+    assert(file.GetStats().FlushedBlocks == 2);
+}
+
+void TestDirectIoQueue() {
+    using namespace NJK;
+
+    const std::string filePath = "./var/direct_io_queue";
+    std::filesystem::remove(filePath);
+
+    const size_t blockCount = 100;
+    TBlockDirectIoFile raw(filePath, 4096);
+    raw.TruncateInBlocks(blockCount);
+    {
+        auto buf = TFixedBuffer::Aligned(4096);
+        for (size_t i = 0; i < blockCount; ++i) {
+            buf.MutableData()[0] = i;
+            raw.WriteBlock(buf, i);
+        }
+    }
+
+    for (bool async : {true, false}) {
+        TDirectIoFile file(filePath);
+        TDirectIoQueue queue(8, async);
+
+        std::vector<TFixedBuffer> bufs;
+        std::vector<TFixedBuffer*> bufPtrs;
+        for (size_t i = 0; i < queue.GetDepth(); ++i) {
+            bufs.push_back(TFixedBuffer::Aligned(4096));
+        }
+        for (auto& buf : bufs) {
+            bufPtrs.push_back(&buf);
+        }
+        const bool fixed = queue.RegisterBuffers(bufPtrs);
+
+        std::vector<size_t> freeBufs;
+        for (size_t i = 0; i < bufs.size(); ++i) {
+            freeBufs.push_back(i);
+        }
+        std::vector<TDirectIoQueue::TCompletion> completions;
+        size_t checked = 0;
+        auto check = [&] {
+            for (const auto& c : completions) {
+                const size_t bufIdx = c.Cookie % bufs.size();
+                assert(c.Result == 4096);
+                assert(bufs[bufIdx].Data()[0] == char(c.Cookie / bufs.size()));
+                freeBufs.push_back(bufIdx);
+                ++checked;
+            }
+        };
+
+        for (size_t i = 0; i < blockCount; ++i) {
+            if (freeBufs.empty()) {
+                queue.Wait(1, completions);
+                check();
+            }
+            const size_t bufIdx = freeBufs.back();
+            freeBufs.pop_back();
+            auto& buf = bufs[bufIdx];
+            queue.Read(file, buf.MutableData(), 4096, i * 4096, i * bufs.size() + bufIdx, fixed ? bufIdx : -1);
+        }
+        queue.Wait(queue.GetInFlight(), completions);
+        check();
+        assert(checked == blockCount);
+    }
+
+    {
+        TCachedBlockFile cached(raw);
+        assert(cached.GetBlock(5).Buf().Data()[0] == 5);
+
+        std::vector<size_t> idxs;
+        for (size_t i = 0; i < blockCount; i += 5) {
+            idxs.push_back(i);
+        }
+        auto pages = cached.GetBlocks(idxs);
+        assert(pages.size() == idxs.size());
+        for (size_t i = 0; i < idxs.size(); ++i) {
+            assert(pages[i].Buf().Data()[0] == char(idxs[i]));
+        }
+        assert(cached.GetStats().Hits == 1);
+    }
+}
+
+void TestBlockCacheReadahead() {
+    using namespace NJK;
+
+    const std::string filePath = "./var/block_cache_readahead";
+    std::filesystem::remove(filePath);
+
+    const size_t blockCount = 256;
+    TBlockDirectIoFile raw(filePath, 4096);
+    raw.TruncateInBlocks(blockCount);
+    {
+        auto buf = TFixedBuffer::Aligned(4096);
+        for (size_t i = 0; i < blockCount; ++i) {
+            buf.MutableData()[0] = i;
+            raw.WriteBlock(buf, i);
+        }
+    }
+
+    {
+        TCachedBlockFile cached(raw);
+        for (size_t i = 0; i < blockCount; ++i) {
+            assert(cached.GetBlock(i).Buf().Data()[0] == char(i));
+        }
+        // Second sequential miss starts readahead, everything else was prefetched
+        const auto stats = cached.GetStats();
+        assert(stats.Misses == 2);
+        assert(stats.PrefetchHits == blockCount - 2);
+        assert(stats.Prefetched == blockCount - 2);
+    }
+
+    {
+        TCachedBlockFile cached(raw);
+        for (size_t i : {250, 10, 100, 40}) {
+            assert(cached.GetBlock(i).Buf().Data()[0] == char(i));
+        }
+        assert(cached.GetStats().Prefetched == 0);
+
+        cached.Prefetch({200, 201, 120, 201});
+        assert(cached.GetStats().Prefetched == 3);
+        assert(cached.GetBlock(120).Buf().Data()[0] == char(120));
+        assert(cached.GetBlock(120).Buf().Data()[0] == char(120));
+        assert(cached.GetStats().PrefetchHits == 1);
+        assert(cached.GetStats().Misses == 4);
+    }
+
+    {
+        TCachedBlockFile::TSettings settings;
+        settings.ReadaheadMax = 0;
+        TCachedBlockFile cached(raw, settings);
+        for (size_t i = 0; i < 16; ++i) {
+            cached.GetBlock(i);
+        }
+        assert(cached.GetStats().Misses == 16);
+        assert(cached.GetStats().Prefetched == 0);
+    }
+}
+
+void TestVectoredBlockIo() {
+    using namespace NJK;
+
+    const std::string filePath = "./var/vectored_block_io";
+    std::filesystem::remove(filePath);
+
+    const size_t blockCount = 32;
+    TBlockDirectIoFile raw(filePath, 4096);
+    raw.TruncateInBlocks(blockCount);
+
+    {
+        const std::vector<size_t> idxs{0, 1, 2, 3, 10, 11, 20};
+        std::vector<TFixedBuffer> bufs;
+        for (size_t i = 0; i < idxs.size(); ++i) {
+            bufs.push_back(TFixedBuffer::Aligned(4096));
+            bufs.back().MutableData()[0] = idxs[i] + 1;
+        }
+        std::vector<const TFixedBuffer*> src;
+        for (auto& buf : bufs) {
+            src.push_back(&buf);
+        }
+        assert(raw.WriteBlocks(src, idxs) == 3);
+
+        std::vector<TFixedBuffer*> dst;
+        for (auto& buf : bufs) {
+            buf.MutableData()[0] = 0;
+            dst.push_back(&buf);
+        }
+        assert(raw.ReadBlocks(dst, idxs) == 3);
+        for (size_t i = 0; i < idxs.size(); ++i) {
+            assert(bufs[i].Data()[0] == char(idxs[i] + 1));
+        }
+    }
+
+    {
+        TCachedBlockFile cached(raw);
+        // Unsorted input, runs are built by block index
+        auto pages = cached.GetBlocks({20, 11, 0, 3, 2, 10, 1});
+        assert(pages[0].Buf().Data()[0] == 21);
+        assert(pages[2].Buf().Data()[0] == 1);
+        assert(pages[5].Buf().Data()[0] == 11);
+        assert(cached.GetStats().Reads == 3);
+        assert(cached.GetStats().Misses == 7);
+    }
+
+    {
+        // Failed reads leave nothing pinned, so the blocks are evicted later
+        TCachedBlockFile::TSettings settings;
+        settings.Capacity = 64;
+        settings.Shards = 1;
+        settings.ReadaheadMax = 0;
+        TCachedBlockFile cached(raw, settings);
+
+        bool thrown = false;
+        try {
+            cached.GetBlocks({5, blockCount + 8});
+        } catch (const std::exception&) {
+            thrown = true;
+        }
+        assert(thrown);
+        thrown = false;
+        try {
+            cached.GetBlock(blockCount + 9);
+        } catch (const std::exception&) {
+            thrown = true;
+        }
+        assert(thrown);
+
+        raw.TruncateInBlocks(8 * blockCount);
+        for (size_t i = blockCount; i < 8 * blockCount; ++i) {
+            cached.GetBlock(i);
+        }
+        const size_t misses = cached.GetStats().Misses;
+        cached.GetBlock(5);
+        cached.GetBlock(blockCount + 8);
+        cached.GetBlock(blockCount + 9);
+        assert(cached.GetStats().Misses == misses + 3);
+    }
+}
+
 template <typename T>
 void AssertValue(const NJK::TVolume::TInode& inode, const T& expect, TInodeDataOps& ops) {
     auto sbinVal = ops.GetValue(inode);
@@ -280,12 +818,12 @@ void TestInodeDataOps() {
 
         auto root = vol.ReadInode(0);
         auto got0 = ops.ListChildren(root);
-        const std::vector<TInodeDataOps::TDirEntry> expect0{{ 1, "bin" }, { 2, "sbin" }, { 3, "root" }, { 4, "home" }, { 5, "etc" }};
+        const std::vector<TInodeDataOps::TDirEntry> expect0{{ 1, "bin" }, { 5, "etc" }, { 4, "home" }, { 3, "root" }, { 2, "sbin" }};
         assert(expect0 == got0);
 
         auto home = vol.ReadInode(4);
         auto got1 = ops.ListChildren(home);
-        const std::vector<TInodeDataOps::TDirEntry> expect1{{ 6, "trofimenkov" }, { 7, "snowball" }};
+        const std::vector<TInodeDataOps::TDirEntry> expect1{{ 7, "snowball" }, { 6, "trofimenkov" }};
         assert(expect1 == got1);
 
         assert(ops.LookupChild(home, "snowball")->Id == 7);
@@ -298,7 +836,7 @@ void TestInodeDataOps() {
 
         ops.RemoveChild(root, "root");
         auto got3 = ops.ListChildren(root);
-        const std::vector<TInodeDataOps::TDirEntry> expect3{{ 1, "bin" }, { 2, "sbin" }, { 4, "home" }, { 5, "etc" }};
+        const std::vector<TInodeDataOps::TDirEntry> expect3{{ 1, "bin" }, { 5, "etc" }, { 4, "home" }, { 2, "sbin" }};
         assert(expect3 == got3);
 
         assert(ops.LookupChild(root, "home")->Id == 4);
@@ -356,6 +894,289 @@ void TestInodeDataOps() {
 
         AssertValue(trofimenkov, (ui32)1987, ops);
 //ops.DumpTree(std::cerr);
+
+        // Small values are inline, bigger ones share slab blocks, the
+        // biggest get whole block, and they move as value size changes
+        using EPlacement = TVolume::TInode::EPlacement;
+        assert(trofimenkov.Val.Placement == EPlacement::Inline);
+        auto home = vol.ReadInode(4);
+        auto sbin = vol.ReadInode(2);
+        assert(home.Val.Placement == EPlacement::Inline);
+
+        const std::string inlined(35, 'a');
+        ops.SetValue(trofimenkov, inlined);
+        assert(trofimenkov.Val.Placement == EPlacement::Inline);
+        AssertValue(trofimenkov, inlined, ops);
+
+        const std::string slotted(100, 's');
+        ops.SetValue(home, inlined + "b");
+        ops.SetValue(sbin, slotted);
+        assert(home.Val.Placement == EPlacement::Slot && sbin.Val.Placement == EPlacement::Slot);
+        assert(home.Val.FirstBlockId != sbin.Val.FirstBlockId); // 64 and 128 bytes classes
+        ops.SetValue(home, slotted + "h");
+        assert(home.Val.FirstBlockId == sbin.Val.FirstBlockId);
+        AssertValue(home, slotted + "h", ops);
+        AssertValue(sbin, slotted, ops);
+
+        const std::string blocked(2000, 'b');
+        ops.SetValue(trofimenkov, blocked);
+        assert(trofimenkov.Val.Placement == EPlacement::Blocks && trofimenkov.Val.BlockCount == 1);
+        AssertValue(trofimenkov, blocked, ops);
+    }
+
+    {
+        TVolume vol(volumePath, {}, false);
+        TInodeDataOps ops(&vol);
+        using EPlacement = TVolume::TInode::EPlacement;
+
+        auto sbin = vol.ReadInode(2);
+        auto home = vol.ReadInode(4);
+        auto trofimenkov = vol.ReadInode(6);
+        AssertValue(sbin, std::string(100, 's'), ops);
+        AssertValue(home, std::string(100, 's') + "h", ops);
+        AssertValue(trofimenkov, std::string(2000, 'b'), ops);
+
+        ops.SetValue(home, (double)0.5);
+        assert(home.Val.Placement == EPlacement::Inline);
+        AssertValue(home, (double)0.5, ops);
+        ops.SetValue(trofimenkov, std::string(100, 't'));
+        assert(trofimenkov.Val.Placement == EPlacement::Slot);
+        AssertValue(trofimenkov, std::string(100, 't'), ops);
+        ops.UnsetValue(home);
+        AssertValue(home, std::monostate{}, ops);
+        ops.UnsetValue(sbin);
+        AssertValue(trofimenkov, std::string(100, 't'), ops);
+        ops.UnsetValue(trofimenkov);
+    }
+}
+
+void TestInodeBigDirectory() {
+    using namespace NJK;
+
+    const std::string volumePath = "./var/volume_big_directory";
+    std::filesystem::remove_all(volumePath);
+
+    TVolume::TSettings settings;
+    const size_t count = 20000;
+
+    // Long names to get several index levels, ~16 entries per leaf
+    auto name = [](size_t i) {
+        return std::string(200, 'x') + std::to_string(i);
+    };
+
+    {
+        TVolume vol(volumePath, settings, false);
+        TInodeDataOps ops(&vol);
+        auto root = vol.AllocateInode();
+        auto dir = ops.AddChild(root, "users");
+
+        std::vector<ui32> ids;
+        for (size_t i = 0; i < count; ++i) {
+            ids.push_back(ops.AddChild(dir, name(i)).Id);
+        }
+        assert(dir.Dir.IndexLevels >= 2);
+
+        bool thrown = false;
+        try {
+            ops.AddChild(dir, name(count / 2));
+        } catch (const std::exception&) {
+            thrown = true;
+        }
+        assert(thrown);
+
+        for (size_t i = 0; i < count; i += 7) {
+            assert(ops.LookupChild(dir, name(i))->Id == ids[i]);
+        }
+        const auto children = ops.ListChildren(dir);
+        assert(children.size() == count);
+        assert(std::is_sorted(children.begin(), children.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.Name < rhs.Name;
+        }));
+    }
+
+    {
+        TVolume vol(volumePath, settings, false);
+        TInodeDataOps ops(&vol);
+        auto root = vol.ReadInode(0);
+        auto dir = *ops.LookupChild(root, "users");
+
+        for (size_t i = 0; i < count; ++i) {
+            assert(ops.LookupChild(dir, name(i)));
+        }
+        assert(!ops.LookupChild(dir, name(count)));
+
+        // Index shrinks back to single leaf, then directory is empty
+        std::vector<size_t> order(count);
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin(), order.end(), std::mt19937{42});
+        for (size_t j = 0; j < count; ++j) {
+            ops.RemoveChild(dir, name(order[j]));
+            if (j % 1000 == 0) {
+                assert(!ops.LookupChild(dir, name(order[j])));
+                assert(ops.LookupChild(dir, name(order.back())));
+            }
+            if (j == count - 2) {
+                assert(dir.Dir.IndexLevels == 0);
+                assert(ops.ListChildren(dir).size() == 1);
+            }
+        }
+        assert(!dir.Dir.HasChildren);
+        assert(ops.ListChildren(dir).empty());
+
+        ops.EnsureChildren(dir, {"a", "b"});
+        assert(ops.ListChildren(dir).size() == 2);
+    }
+}
+
+void TestDirLeafBlock() {
+    using namespace NJK;
+    using NVolume::TDirLeafBlock;
+
+    auto buf = TFixedBuffer::Aligned(4096);
+    TDirLeafBlock::Init(buf);
+
+    auto name = [](size_t i) {
+        return std::string(100, 'a') + std::to_string(i);
+    };
+    auto append = [&](size_t i) {
+        return TDirLeafBlock::Insert(buf, i + 1, name(i));
+    };
+    auto remove = [&](size_t i) {
+        return TDirLeafBlock::Remove(buf, name(i));
+    };
+    auto find = [&](size_t i) {
+        return TDirLeafBlock::Find(buf, name(i));
+    };
+
+    size_t count = 0;
+    while (append(count)) {
+        ++count;
+    }
+    assert(count == 37);
+    assert(TDirLeafBlock::GetCount(buf) == count);
+
+    // Hole in the middle of entries, garbage is reused only by compaction
+    assert(*remove(10) == 11);
+    assert(!remove(10));
+    assert(!find(10));
+    assert(*find(11) == 12);
+    assert(TDirLeafBlock::GetCount(buf) == count - 1);
+    assert(append(100));
+    assert(*find(100) == 101);
+    assert(*find(36) == 37);
+
+    // Last entry is just cut
+    assert(remove(100));
+    assert(append(101));
+    assert(!append(102));
+
+    std::vector<std::string> names;
+    TDirLeafBlock::ForEach(buf, [&](ui32, std::string_view name) {
+        names.emplace_back(name);
+    });
+    assert(names.size() == count && std::is_sorted(names.begin(), names.end()));
+    assert(TDirLeafBlock::GetEntry(buf, TDirLeafBlock::LowerBound(buf, name(2))).Name == name(2));
+    assert(TDirLeafBlock::LowerBound(buf, "b") == count);
+
+    for (size_t i = 0; i < count; ++i) {
+        if (i != 10) {
+            assert(remove(i));
+        }
+        if (i == 20) {
+            assert(TDirLeafBlock::NeedsCompaction(buf));
+            TDirLeafBlock::Compact(buf);
+            assert(!TDirLeafBlock::NeedsCompaction(buf));
+            assert(*find(21) == 22);
+            assert(*find(101) == 102);
+            std::vector<std::string> left;
+            TDirLeafBlock::ForEach(buf, [&](ui32, std::string_view name) {
+                left.emplace_back(name);
+            });
+            assert(left.size() == count - 20 && std::is_sorted(left.begin(), left.end()));
+        }
+    }
+
+    std::vector<ui32> ids;
+    TDirLeafBlock::ForEach(buf, [&](ui32 id, std::string_view) {
+        ids.push_back(id);
+    });
+    assert(ids == std::vector<ui32>{102});
+}
+
+void TestInodeBigValues() {
+    using namespace NJK;
+    using EPlacement = TVolume::TInode::EPlacement;
+
+    const std::string volumePath = "./var/volume_big_values";
+    std::filesystem::remove_all(volumePath);
+
+    auto makeValue = [](size_t size, char seed) {
+        std::string ret(size, 0);
+        for (size_t i = 0; i < size; ++i) {
+            ret[i] = seed + i % 31;
+        }
+        return ret;
+    };
+
+    {
+        TVolume vol(volumePath, {}, false);
+        TInodeDataOps ops(&vol);
+        auto root = vol.AllocateInode();
+        auto a = ops.AddChild(root, "a");
+        auto b = ops.AddChild(root, "b");
+
+        ops.SetValue(a, makeValue(1 << 20, 'a'));
+        assert(a.Val.Placement == EPlacement::Blocks && a.Val.BlockCount == 257);
+        ops.SetValue(b, makeValue(4092, 'b')); // exactly one block
+        assert(b.Val.BlockCount == 1);
+        AssertValue(b, makeValue(4092, 'b'), ops);
+        ops.SetValue(b, makeValue(100 << 10, 'b'));
+        assert(b.Val.BlockCount == 26);
+        AssertValue(a, makeValue(1 << 20, 'a'), ops);
+        AssertValue(b, makeValue(100 << 10, 'b'), ops);
+    }
+
+    {
+        TVolume vol(volumePath, {}, false);
+        TInodeDataOps ops(&vol);
+        auto root = vol.ReadInode(0);
+        auto a = *ops.LookupChild(root, "a");
+        auto b = *ops.LookupChild(root, "b");
+
+        // Whole value at once
+        const size_t reads = vol.GetCacheStats().Reads;
+        AssertValue(a, makeValue(1 << 20, 'a'), ops);
+        assert(vol.GetCacheStats().Reads - reads <= 2);
+
+        // Same size is overwritten in place, other one is moved
+        const ui32 first = a.Val.FirstBlockId;
+        ops.SetValue(a, makeValue(1 << 20, 'A'));
+        assert(a.Val.FirstBlockId == first);
+        ops.SetValue(b, makeValue(2 << 20, 'B'));
+        ops.SetValue(a, std::string{"small"});
+        assert(a.Val.Placement == EPlacement::Inline);
+        AssertValue(b, makeValue(2 << 20, 'B'), ops);
+        ops.UnsetValue(b);
+        AssertValue(b, std::monostate{}, ops);
+
+        // Removed children free their value storage
+        auto c = ops.AddChild(root, "c");
+        auto d = ops.AddChild(root, "d");
+        ops.SetValue(c, makeValue(1 << 20, 'c'));
+        ops.SetValue(d, makeValue(200, 'd'));
+        assert(d.Val.Placement == EPlacement::Slot);
+        const ui32 blocksFirst = c.Val.FirstBlockId;
+        const ui32 slabBlock = d.Val.FirstBlockId;
+        ops.RemoveChild(root, "c");
+        ops.RemoveChild(root, "d");
+        auto e = ops.AddChild(root, "e");
+        auto f = ops.AddChild(root, "f");
+        ops.SetValue(e, makeValue(1 << 20, 'e'));
+        ops.SetValue(f, makeValue(200, 'f'));
+        assert(e.Val.FirstBlockId == blocksFirst);
+        assert(f.Val.FirstBlockId == slabBlock);
+        AssertValue(e, makeValue(1 << 20, 'e'), ops);
+        AssertValue(f, makeValue(200, 'f'), ops);
     }
 }
 
@@ -695,12 +1516,371 @@ libfoo.so = ui32 155
     }
 }
 
-void TestStorageNonRoot() {
+void TestStoragePathCache() {
     using namespace NJK;
-    //using TValue = TInodeValue;
+    using TValue = TInodeValue;
 
-    VOLUME_PATH(rootOld)
-    VOLUME_PATH(rootNew)
+    VOLUME_PATH(root)
+    VOLUME_PATH(home)
+
+    {
+        VOLUME(root);
+        VOLUME(home);
+
+        {
+            auto storage = TStorage::Build(&home);
+            storage.Set("/leva/.vimrc", std::string{"set hls"});
+        }
+
+        {
+            auto storage = TStorageBuilder(&root)
+                .PathCache()
+                .Mount("/home", &home)
+                .Build();
+
+            // Second time from path cache
+            for (size_t i = 0; i < 2; ++i) {
+                AssertValuesEqual(storage.Get("/home/leva/.vimrc"), TValue{std::string{"set hls"}});
+                AssertValuesEqual(storage.Get("/home/leva"), {});
+                AssertValuesEqual(storage.Get("/home/petrk"), {});
+            }
+
+            // Missing paths are not cached
+            storage.Set("/home/petrk", (ui32)43);
+            AssertValuesEqual(storage.Get("/home/petrk"), (ui32)43);
+
+            storage.Set("/home/leva/.vimrc", std::string{"set nohls"});
+            AssertValuesEqual(storage.Get("/home/leva/.vimrc"), TValue{std::string{"set nohls"}});
+            storage.Erase("/home/leva/.vimrc");
+            AssertValuesEqual(storage.Get("/home/leva/.vimrc"), {});
+            storage.Set("/home/leva/.vimrc", std::string{"set hls"});
+            AssertValuesEqual(storage.Get("/home/leva/.vimrc"), TValue{std::string{"set hls"}});
+        }
+
+        AssertTreeEqual(home, R"(
+leva
+    .vimrc = string "set hls"
+petrk = ui32 43
+)");
+    }
+}
+
+void TestStorageConcurrentValue() {
+    using namespace NJK;
+    using TValue = TInodeValue;
+
+    VOLUME_PATH(root)
+
+    {
+        VOLUME(root);
+        auto storage = TStorage::Build(&root);
+
+        // Too big to be kept in dentry, goes to disk
+        const std::string big(200, 'x');
+        storage.Set("/key", (ui32)1);
+        storage.Set("/key", big);
+        AssertValuesEqual(storage.Get("/key"), TValue{big});
+        storage.Set("/key", (ui32)2);
+        AssertValuesEqual(storage.Get("/key"), (ui32)2);
+
+        std::atomic<bool> stop{false};
+        std::vector<std::thread> readers;
+        for (size_t t = 0; t < 3; ++t) {
+            readers.emplace_back([&] {
+                ui32 prev = 0;
+                while (!stop.load()) {
+                    auto val = storage.Get("/key");
+                    if (auto* num = std::get_if<ui32>(&val)) {
+                        assert(*num >= prev); // no going back in time
+                        prev = *num;
+                    } else {
+                        assert(std::get<std::string>(val) == big);
+                    }
+                }
+            });
+        }
+        for (ui32 i = 3; i < 3000; ++i) {
+            if (i % 100 == 0) {
+                storage.Set("/key", big);
+            } else {
+                storage.Set("/key", i);
+            }
+        }
+        stop = true;
+        for (auto& t : readers) {
+            t.join();
+        }
+        AssertValuesEqual(storage.Get("/key"), (ui32)2999);
+    }
+}
+
+void TestStorageDentryEviction() {
+    using namespace NJK;
+
+    VOLUME_PATH(root)
+
+    {
+        VOLUME(root);
+
+        auto key = [](size_t i, size_t j) {
+            return "/dir_" + std::to_string(i) + "/key_" + std::to_string(j);
+        };
+
+        {
+            auto storage = TStorageBuilder(&root)
+                .PathCache()
+                .DentryCache({.MaxDentries = 16, .MaxNegativeDentries = 4, .MaxPaths = 8})
+                .Build();
+
+            for (size_t i = 0; i < 10; ++i) {
+                for (size_t j = 0; j < 10; ++j) {
+                    storage.Set(key(i, j), (ui32)(i * 10 + j));
+                }
+            }
+            // Evicted dentries are flushed and read back from disk
+            for (size_t round = 0; round < 2; ++round) {
+                for (size_t i = 0; i < 10; ++i) {
+                    for (size_t j = 0; j < 10; ++j) {
+                        AssertValuesEqual(storage.Get(key(i, j)), (ui32)(i * 10 + j));
+                        AssertValuesEqual(storage.Get(key(i, j) + "_missing"), {});
+                    }
+                }
+            }
+            // Negative dentry which became existing one
+            storage.Set(key(0, 0) + "_missing", (ui32)1);
+            AssertValuesEqual(storage.Get(key(0, 0) + "_missing"), (ui32)1);
+
+            const auto stats = storage.GetDentryCacheStats();
+            assert(stats.Dentries <= 16);
+            assert(stats.NegativeDentries <= 4);
+            assert(stats.Paths <= 8);
+            assert(stats.Evictions > 0);
+            assert(stats.NegativeEvictions > 0);
+            assert(stats.PathEvictions > 0);
+            assert(stats.Overflows == 0);
+        }
+
+        auto storage = TStorage::Build(&root);
+        for (size_t i = 0; i < 10; ++i) {
+            for (size_t j = 0; j < 10; ++j) {
+                AssertValuesEqual(storage.Get(key(i, j)), (ui32)(i * 10 + j));
+            }
+        }
+        AssertValuesEqual(storage.Get(key(0, 0) + "_missing"), (ui32)1);
+    }
+}
+
+void TestStorageMultiGetSet() {
+    using namespace NJK;
+    using TValue = TInodeValue;
+
+    VOLUME_PATH(root)
+    VOLUME_PATH(home)
+    VOLUME_PATH(bulk)
+
+    {
+        VOLUME(root);
+        VOLUME(home);
+
+        {
+            auto storage = TStorage::Build(&home);
+            storage.Set("/leva/.vimrc", std::string{"set hls"});
+        }
+
+        {
+            auto storage = TStorageBuilder(&root)
+                .Mount("/home", &home)
+                .Build();
+
+            storage.Set("/etc/passwd", (ui32)1);
+
+            const std::vector<std::pair<std::string, TValue>> items{
+                {"/etc/hosts", (ui32)2},
+                {"/home/leva/.vimrc", std::string{"set nohls"}},
+                {"/etc/passwd", (ui32)3},
+                {"/home/leva/.bashrc", std::string{"ls"}},
+                {"/etc//hosts", (ui32)4}, // same key, later wins
+                {"/var/log/", 0.5},
+            };
+            storage.MultiSet(items);
+
+            const std::vector<std::string> paths{
+                "/etc/hosts",
+                "/etc/passwd",
+                "/etc/shadow",
+                "/home/leva/.vimrc",
+                "/home/leva/.bashrc",
+                "/var/log",
+                "/usr/bin/ls",
+            };
+            const auto values = storage.MultiGet(paths);
+            assert(values.size() == paths.size());
+            for (size_t i = 0; i < paths.size(); ++i) {
+                AssertValuesEqual(values[i], storage.Get(paths[i]));
+            }
+            AssertValuesEqual(values[0], (ui32)4);
+            AssertValuesEqual(values[1], (ui32)3);
+            AssertValuesEqual(values[2], {});
+            AssertValuesEqual(values[6], {});
+        }
+
+        AssertTreeEqual(root, R"(
+etc
+    hosts = ui32 4
+    passwd = ui32 3
+home
+var
+    log = double 0.5
+)");
+        AssertTreeEqual(home, R"(
+leva
+    .bashrc = string "ls"
+    .vimrc = string "set nohls"
+)");
+    }
+
+    // Many new keys of one directory with path cache
+    {
+        VOLUME(bulk);
+
+        auto key = [](size_t i) {
+            return "/dir/key_" + std::to_string(i);
+        };
+
+        std::vector<std::pair<std::string, TValue>> items;
+        std::vector<std::string> paths;
+        for (size_t i = 0; i < 200; ++i) {
+            items.emplace_back(key(i), (ui32)i);
+            paths.push_back(key(i));
+        }
+
+        {
+            auto storage = TStorageBuilder(&bulk)
+                .PathCache()
+                .Build();
+            storage.MultiSet(items);
+            for (size_t round = 0; round < 2; ++round) {
+                const auto values = storage.MultiGet(paths);
+                for (size_t i = 0; i < paths.size(); ++i) {
+                    AssertValuesEqual(values[i], (ui32)i);
+                }
+            }
+        }
+
+        auto storage = TStorage::Build(&bulk);
+        const auto values = storage.MultiGet(paths);
+        for (size_t i = 0; i < paths.size(); ++i) {
+            AssertValuesEqual(values[i], (ui32)i);
+        }
+    }
+}
+
+void TestStorageAtomicUpdate() {
+    using namespace NJK;
+    using TValue = TInodeValue;
+
+    VOLUME_PATH(root)
+
+    const std::string big(200, 'x');
+    // b is kept either as ui32 or as big string with number at the end
+    auto parse = [&](const TValue& cur) -> ui32 {
+        if (const auto* num = std::get_if<ui32>(&cur)) {
+            return *num;
+        }
+        return std::stoul(std::get<std::string>(cur).substr(big.size()));
+    };
+
+    {
+        VOLUME(root);
+
+        {
+            auto storage = TStorage::Build(&root);
+
+            assert(storage.Increment("/counters/a") == 1);
+            assert(storage.Increment("/counters/a", 10) == 11);
+
+            storage.Set("/name", std::string{"leva"});
+            bool thrown = false;
+            try {
+                storage.Increment("/name");
+            } catch (const std::runtime_error&) {
+                thrown = true;
+            }
+            assert(thrown);
+
+            assert(!storage.CompareAndSet("/name", std::string{"petrk"}, std::string{"trofimenkov"}));
+            assert(storage.CompareAndSet("/name", std::string{"leva"}, std::string{"trofimenkov"}));
+            AssertValuesEqual(storage.Get("/name"), TValue{std::string{"trofimenkov"}});
+            assert(!storage.CompareAndSet("/missing", (ui32)1, (ui32)2));
+            assert(storage.CompareAndSet("/created", {}, (ui32)2));
+            AssertValuesEqual(storage.Get("/created"), (ui32)2);
+
+            // To disk and back
+            auto prev = storage.Update("/counters/a", [&](const TValue&) -> std::optional<TValue> {
+                return big;
+            });
+            AssertValuesEqual(prev, (ui32)11);
+            prev = storage.Update("/counters/a", [&](const TValue& cur) -> std::optional<TValue> {
+                return (ui32)std::get<std::string>(cur).size();
+            });
+            AssertValuesEqual(prev, TValue{big});
+            AssertValuesEqual(storage.Get("/counters/a"), (ui32)200);
+
+            // Lock-free increments race with ones that go through disk
+            storage.Set("/counters/b", (ui32)0);
+            std::vector<std::thread> threads;
+            for (size_t t = 0; t < 4; ++t) {
+                threads.emplace_back([&, t] {
+                    for (size_t i = 0; i < 2000; ++i) {
+                        if (t == 0 && i % 10 == 0) {
+                            storage.Update("/counters/b", [&](const TValue& cur) -> std::optional<TValue> {
+                                return big + std::to_string(parse(cur) + 1);
+                            });
+                        } else if (t == 1) {
+                            storage.Update("/counters/b", [&](const TValue& cur) -> std::optional<TValue> {
+                                return parse(cur) + 1;
+                            });
+                        } else {
+                            storage.Increment("/counters/c");
+                        }
+                    }
+                });
+            }
+            for (auto& t : threads) {
+                t.join();
+            }
+            assert(parse(storage.Get("/counters/b")) == 2200);
+            AssertValuesEqual(storage.Get("/counters/c"), (ui32)5800);
+
+            storage.Set("/ttl", (ui32)1, 12345);
+        }
+
+        // Update without deadline keeps the one of value read from disk
+        {
+            auto storage = TStorage::Build(&root);
+            assert(storage.Increment("/ttl") == 2);
+        }
+        {
+            TInodeDataOps ops(&root);
+            auto rootInode = root.ReadInode(0);
+            const auto ttl = *ops.LookupChild(rootInode, "ttl");
+            assert(ttl.Val.Deadline == 12345);
+            AssertValuesEqual(ops.GetValue(ttl), (ui32)2);
+        }
+
+        auto storage = TStorage::Build(&root);
+        AssertValuesEqual(storage.Get("/counters/a"), (ui32)200);
+        assert(parse(storage.Get("/counters/b")) == 2200);
+        AssertValuesEqual(storage.Get("/counters/c"), (ui32)5800);
+    }
+}
+
+void TestStorageNonRoot() {
+    using namespace NJK;
+    //using TValue = TInodeValue;
+
+    VOLUME_PATH(rootOld)
+    VOLUME_PATH(rootNew)
     VOLUME_PATH(home)
 
     {
@@ -808,6 +1988,324 @@ void TestHashMapConcurrency() {
     assert(my[77]->load(std::memory_order::relaxed) == 2000000);
 }
 
+// Overlapping inserts while table grows: each key is created exactly once
+void TestAdaptiveLock() {
+    using namespace NJK;
+
+    TAdaptiveLock lock;
+    assert(lock.try_lock());
+    assert(!lock.try_lock());
+    lock.unlock();
+
+    // More threads than cores, so some of them end up in futex
+    const size_t threadCount = 16;
+    const size_t opCount = 20000;
+    size_t counter = 0;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&] {
+            for (size_t i = 0; i < opCount; ++i) {
+                auto g = MakeGuard(lock);
+                ++counter;
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    assert(counter == threadCount * opCount);
+}
+
+void TestHashMapConcurrentInsert() {
+    using namespace NJK;
+
+    THashMap<size_t, std::atomic<size_t>> my;
+    const size_t threadCount = 8;
+    const size_t keyCount = 20000;
+    std::atomic<size_t> created{0};
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t] {
+            for (size_t i = 0; i < keyCount; ++i) {
+                const size_t key = (i * 7919 + t) % keyCount;
+                auto res = my.emplace_key(key);
+                if (res.Created) {
+                    created.fetch_add(1, std::memory_order::relaxed);
+                }
+                res.Obj->fetch_add(1, std::memory_order::relaxed);
+                assert(my.Find(key));
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    assert(created == keyCount);
+    assert(my.size() == keyCount);
+    assert(my.bucket_count() >= keyCount);
+    assert(!my.Find(keyCount + 1));
+
+    size_t total = 0;
+    size_t count = 0;
+    my.Iterate([&](size_t, std::atomic<size_t>& value) {
+        total += value.load();
+        ++count;
+    });
+    assert(count == keyCount);
+    assert(total == threadCount * keyCount);
+}
+
+void TestHashMapErase() {
+    using namespace NJK;
+
+    // Poisoned in destructor, so holder would see use after free
+    struct TItem {
+        ~TItem() {
+            Alive = false;
+        }
+
+        std::atomic<bool> Alive{true};
+        std::atomic<size_t> Key{0};
+    };
+
+    {
+        THashMap<size_t, TItem> my;
+        assert(!my.Erase(1));
+        {
+            auto item = my[1];
+            item->Key = 1;
+            assert(!my.Erase(1)); // referenced
+        }
+        assert(!my.TryEvict(1, [](TItem&) { return false; }));
+        assert(my.Find(1));
+        assert(my.Erase(1));
+        assert(!my.Find(1));
+        assert(my.size() == 0);
+        assert(my.emplace_key(1).Created);
+    }
+
+    const size_t threadCount = 8;
+    const size_t keyCount = 64;
+    const size_t opCount = 50000;
+    std::atomic<size_t> erased{0};
+    {
+        THashMap<size_t, TItem> my;
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < threadCount; ++t) {
+            threads.emplace_back([&, t] {
+                std::mt19937 rng(t);
+                std::uniform_int_distribution<size_t> dist(0, keyCount - 1);
+                for (size_t i = 0; i < opCount; ++i) {
+                    const size_t key = dist(rng);
+                    if (i % 3) {
+                        auto res = my.emplace_key(key);
+                        if (res.Created) {
+                            res.Obj->Key = key;
+                        }
+                        std::this_thread::yield();
+                        assert(res.Obj->Alive);
+                        const size_t k = res.Obj->Key;
+                        assert(k == key || k == 0);
+                    } else if (my.Erase(key)) {
+                        erased.fetch_add(1, std::memory_order::relaxed);
+                    }
+                }
+                TEpoch::Collect();
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+
+        size_t count = 0;
+        my.Iterate([&](size_t, TItem& item) {
+            assert(item.Alive);
+            ++count;
+        });
+        assert(count == my.size());
+        assert(count <= keyCount);
+    }
+    assert(erased > 0);
+
+    // Nobody is inside critical section, so everything retired can be freed
+    for (size_t i = 0; i < 3; ++i) {
+        TEpoch::Collect();
+    }
+    assert(TEpoch::GetPendingCount() == 0);
+}
+
+void TestHashMapHeterogeneousLookup() {
+    using namespace NJK;
+
+    struct TStringHash {
+        using is_transparent = void;
+
+        size_t operator() (std::string_view s) const {
+            return std::hash<std::string_view>{}(s);
+        }
+    };
+
+    THashMap<std::string, size_t, TStringHash> my;
+    const std::string_view path = "/home/user/.vimrc";
+    const std::string_view name = path.substr(6, 4);
+
+    assert(!my.Find(name));
+    {
+        auto res = my.emplace_key(name);
+        assert(res.Created);
+        *res.Obj = 1;
+    }
+    {
+        auto res = my.emplace_key(name);
+        assert(!res.Created);
+        assert(*res.Obj == 1);
+    }
+    assert(*my.Find(std::string("user")) == 1);
+    assert(*my.Find(name) == 1);
+    assert(!my.Find(path.substr(6, 3)));
+
+    size_t count = 0;
+    my.Iterate([&](const std::string& key, size_t) {
+        assert(key == "user");
+        ++count;
+    });
+    assert(count == 1);
+}
+
+// Lookups of hot keys from many threads, with and without concurrent growth
+void BenchHashMapContention() {
+    using namespace NJK;
+
+    const size_t keyCount = 100000;
+    const size_t opCount = 2000000;
+
+    for (bool grow : {false, true}) {
+        for (size_t threadCount : {1, 2, 4, 8, 16, 32, 64}) {
+            THashMap<size_t, std::atomic<size_t>> my;
+            for (size_t i = 0; i < keyCount; ++i) {
+                my[i];
+            }
+
+            std::atomic<bool> stop{false};
+            std::thread writer;
+            if (grow) {
+                writer = std::thread([&] {
+                    for (size_t i = keyCount; !stop.load(std::memory_order::relaxed); ++i) {
+                        my[i];
+                    }
+                });
+            }
+
+            std::vector<std::thread> threads;
+            auto start = std::chrono::system_clock::now();
+            for (size_t t = 0; t < threadCount; ++t) {
+                threads.emplace_back([&, t] {
+                    std::mt19937 rng(t);
+                    std::uniform_int_distribution<size_t> dist(0, keyCount - 1);
+                    for (size_t i = 0; i < opCount / threadCount; ++i) {
+                        my.Find(dist(rng))->fetch_add(1, std::memory_order::relaxed);
+                    }
+                });
+            }
+            for (auto& t : threads) {
+                t.join();
+            }
+            auto finish = std::chrono::system_clock::now();
+            stop = true;
+            if (writer.joinable()) {
+                writer.join();
+            }
+            const std::chrono::duration<double> elapsed_seconds = finish - start;
+
+            std::cerr << "grow: " << grow
+                << ", threads: " << threadCount
+                << ", lookups/sec: " << size_t(opCount / elapsed_seconds.count())
+                << ", size: " << my.size()
+                << '\n';
+        }
+    }
+}
+
+// Single thread lookups in big maps, std::unordered_map (chained) for reference
+void BenchHashMapLayout(size_t keyCount) {
+    using namespace NJK;
+
+    // Same shape as dentry cache key in storage.cpp
+    struct TDentryKey {
+        ui64 ParentInode = 0;
+        std::string ChildName;
+
+        bool operator== (const TDentryKey& other) const {
+            return ParentInode == other.ParentInode && ChildName == other.ChildName;
+        }
+    };
+
+    struct TDentryKeyHash {
+        size_t operator() (const TDentryKey& key) const {
+            return std::hash<ui64>{}(key.ParentInode) ^ std::hash<std::string>{}(key.ChildName);
+        }
+    };
+
+    const size_t opCount = 5000000;
+
+    auto run = [&](const char* name, auto& map, auto&& makeKey, auto&& find) {
+        auto start = std::chrono::system_clock::now();
+        for (size_t i = 0; i < keyCount; ++i) {
+            map[makeKey(i)];
+        }
+        auto mid = std::chrono::system_clock::now();
+
+        std::mt19937 rng(0);
+        std::uniform_int_distribution<size_t> dist(0, keyCount * 2 - 1);
+        size_t hits = 0;
+        for (size_t i = 0; i < opCount; ++i) {
+            hits += find(map, makeKey(dist(rng)));
+        }
+        auto finish = std::chrono::system_clock::now();
+
+        const std::chrono::duration<double> insert = mid - start;
+        const std::chrono::duration<double> lookup = finish - mid;
+        std::cerr << name
+            << ", keys: " << keyCount
+            << ", inserts/sec: " << size_t(keyCount / insert.count())
+            << ", lookups/sec: " << size_t(opCount / lookup.count())
+            << ", hit ratio: " << hits * 1.0 / opCount
+            << '\n';
+    };
+
+    auto pageKey = [](size_t i) {
+        return ui32(i * 2654435761u);
+    };
+    auto dentryKey = [](size_t i) {
+        return TDentryKey{i % 1024, "file_" + std::to_string(i)};
+    };
+    auto findMy = [](auto& map, const auto& key) {
+        return bool(map.Find(key));
+    };
+    auto findStd = [](auto& map, const auto& key) {
+        return map.find(key) != map.end();
+    };
+
+    {
+        THashMap<ui32, ui64> my;
+        run("THashMap<ui32>", my, pageKey, findMy);
+    }
+    {
+        std::unordered_map<ui32, ui64> std;
+        run("unordered_map<ui32>", std, pageKey, findStd);
+    }
+    {
+        THashMap<TDentryKey, ui64, TDentryKeyHash> my;
+        run("THashMap<TDentryKey>", my, dentryKey, findMy);
+    }
+    {
+        std::unordered_map<TDentryKey, ui64, TDentryKeyHash> std;
+        run("unordered_map<TDentryKey>", std, dentryKey, findStd);
+    }
+}
+
 void TestConcurrencySeparateSettersGetters() {
     using namespace NJK;
 
@@ -876,31 +2374,19 @@ void TestConcurrencyIncrement() {
     }
 
     auto load = [&keys, &s](const ui32 div) {
-        size_t getCount = 0;
-        size_t setCount = 0;
+        size_t incrementCount = 0;
         size_t eraseCount = 0;
 
-        std::vector<ui32> prevs;
-        prevs.resize(keys.size());
-
         auto start = std::chrono::system_clock::now();
 
         for (size_t i = 0; i < 10000; ++i) {
-            for (size_t keyIdx = 0; keyIdx < keys.size(); ++keyIdx) {
-                const auto& key = keys[keyIdx];
+            for (const auto& key : keys) {
                 if (i % div == 0) {
                     s.Erase(key);
                     ++eraseCount;
                 } else {
-                    auto& prev = prevs[keyIdx];
-                    auto val = s.Get(key);
-                    ++getCount;
-                    if (auto* cur = std::get_if<ui32>(&val)) {
-                        prev = *cur;
-                    }
-                    s.Set(key, (ui32)(prev + 1));
-                    ++setCount;
-                    ++prev;
+                    s.Increment(key);
+                    ++incrementCount;
                 }
             }
             if (i % 1000 == 0) {
@@ -910,11 +2396,10 @@ void TestConcurrencyIncrement() {
 
         auto finish = std::chrono::system_clock::now();
         const std::chrono::duration<double> elapsed_seconds = finish - start;
-        std::cerr << "getCount: " << getCount
-            << ", setCount: " << setCount
+        std::cerr << "incrementCount: " << incrementCount
             << ", eraseCount: " << eraseCount
             << ", " << elapsed_seconds.count()
-            << ", " << (elapsed_seconds.count() / (getCount + setCount + eraseCount))
+            << ", " << (elapsed_seconds.count() / (incrementCount + eraseCount))
             << '\n';
     };
 
@@ -935,6 +2420,166 @@ void TestConcurrencyIncrement() {
     inc2.join();
 }
 
+// Short critical sections from 1-64 threads and 2x oversubscribed
+void BenchLocks() {
+    using namespace NJK;
+
+    const size_t opCount = 2000000;
+
+    auto run = [&](const char* name, auto& lock, size_t threadCount) {
+        size_t counter = 0;
+        std::vector<std::thread> threads;
+        auto start = std::chrono::system_clock::now();
+        for (size_t t = 0; t < threadCount; ++t) {
+            threads.emplace_back([&] {
+                for (size_t i = 0; i < opCount / threadCount; ++i) {
+                    auto g = MakeGuard(lock);
+                    ++counter;
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        auto finish = std::chrono::system_clock::now();
+        const std::chrono::duration<double> elapsed_seconds = finish - start;
+        assert(counter == opCount / threadCount * threadCount);
+
+        std::cerr << name
+            << ", threads: " << threadCount
+            << ", locks/sec: " << size_t(counter / elapsed_seconds.count())
+            << '\n';
+    };
+
+    std::vector<size_t> threadCounts{1, 2, 4, 8, 16, 32, 64};
+    threadCounts.push_back(2 * std::max(1u, std::thread::hardware_concurrency()));
+    for (size_t threadCount : threadCounts) {
+        TNaiveSpinLock spin;
+        run("TNaiveSpinLock", spin, threadCount);
+        TAdaptiveLock adaptive;
+        run("TAdaptiveLock", adaptive, threadCount);
+        std::mutex mutex;
+        run("std::mutex", mutex, threadCount);
+    }
+}
+
+// Increment workload over keys of different depth, with and without path cache
+void BenchPathCache() {
+    using namespace NJK;
+
+    const size_t threadCount = 3;
+    const size_t iterCount = 1000;
+
+    for (size_t depth : {2, 4, 6, 8}) {
+        for (bool pathCache : {false, true}) {
+            VOLUME_PATH(root);
+            VOLUME(root);
+            TStorageBuilder builder(&root);
+            if (pathCache) {
+                builder.PathCache();
+            }
+            auto s = builder.Build();
+
+            std::vector<std::string> keys;
+            for (size_t i = 0; i < 10; ++i) {
+                for (size_t j = 0; j < 10; ++j) {
+                    std::stringstream key;
+                    for (size_t level = 0; level + 2 < depth; ++level) {
+                        key << "/dir_" << level;
+                    }
+                    key << "/login_" << i << "/file_" << j;
+                    keys.push_back(key.str());
+                }
+            }
+
+            auto start = std::chrono::system_clock::now();
+            std::vector<std::thread> threads;
+            for (size_t t = 0; t < threadCount; ++t) {
+                threads.emplace_back([&] {
+                    for (size_t i = 0; i < iterCount; ++i) {
+                        for (const auto& key : keys) {
+                            ui32 prev = 0;
+                            auto val = s.Get(key);
+                            if (auto* cur = std::get_if<ui32>(&val)) {
+                                prev = *cur;
+                            }
+                            s.Set(key, (ui32)(prev + 1));
+                        }
+                    }
+                });
+            }
+            for (auto& t : threads) {
+                t.join();
+            }
+            auto finish = std::chrono::system_clock::now();
+            const std::chrono::duration<double> elapsed_seconds = finish - start;
+
+            std::cerr << "depth: " << depth
+                << ", path cache: " << pathCache
+                << ", ops/sec: " << size_t(threadCount * iterCount * keys.size() * 2 / elapsed_seconds.count())
+                << '\n';
+        }
+    }
+}
+
+// Fresh keys, then the same keys once more, one by one and in batches
+void BenchMultiGetSet() {
+    using namespace NJK;
+    using TValue = TInodeValue;
+
+    const size_t dirCount = 5;
+    const size_t keysPerDir = 200; // one directory block
+
+    for (bool multi : {false, true}) {
+        VOLUME_PATH(root);
+        VOLUME(root);
+        auto s = TStorage::Build(&root);
+
+        std::vector<std::pair<std::string, TValue>> items;
+        std::vector<std::string> paths;
+        for (size_t i = 0; i < keysPerDir; ++i) {
+            for (size_t d = 0; d < dirCount; ++d) {
+                std::string path = "/users/login_" + std::to_string(d) + "/key_" + std::to_string(i);
+                items.emplace_back(path, (ui32)i);
+                paths.push_back(std::move(path));
+            }
+        }
+
+        auto measure = [&](const char* name, auto&& f) {
+            auto start = std::chrono::system_clock::now();
+            f();
+            auto finish = std::chrono::system_clock::now();
+            const std::chrono::duration<double> elapsed_seconds = finish - start;
+            std::cerr << "multi: " << multi
+                << ", " << name
+                << ", ops/sec: " << size_t(paths.size() / elapsed_seconds.count())
+                << '\n';
+        };
+
+        for (const char* name : {"set new", "set existing"}) {
+            measure(name, [&] {
+                if (multi) {
+                    s.MultiSet(items);
+                } else {
+                    for (const auto& [path, value] : items) {
+                        s.Set(path, value);
+                    }
+                }
+            });
+        }
+        measure("get", [&] {
+            if (multi) {
+                auto values = s.MultiGet(paths);
+                assert(values.size() == paths.size());
+            } else {
+                for (const auto& path : paths) {
+                    s.Get(path);
+                }
+            }
+        });
+    }
+}
+
 #if 0
 int RunBenchmarks(int argc, char** argv) {
     ::benchmark::Initialize(&argc, argv);
@@ -945,10 +2590,433 @@ int RunBenchmarks(int argc, char** argv) {
 }
 #endif
 
+// Random reads over growing working set with fixed cache size
+void BenchBlockCache() {
+    using namespace NJK;
+
+    const std::string volumePath = "./var/volume_bench_cache";
+
+    TVolume::TSettings settings;
+    settings.BlockCacheSize = 8_MiB;
+    const size_t capacity = settings.BlockCacheSize / settings.BlockSize;
+    const size_t readCount = 200000;
+
+    for (size_t workingSet : {capacity / 4, capacity / 2, capacity, capacity * 2, capacity * 4, capacity * 8}) {
+        std::filesystem::remove_all(volumePath);
+        TVolume vol(volumePath, settings, false);
+
+        for (size_t i = 0; i < workingSet; ++i) {
+            auto block = vol.GetMutableDataBlock(vol.AllocateDataBlock());
+            block.Buf().MutableData()[0] = i % 128;
+        }
+        const auto before = vol.GetCacheStats();
+
+        std::mt19937 rng(workingSet);
+        std::uniform_int_distribution<ui32> dist(0, workingSet - 1);
+
+        size_t sum = 0;
+        auto start = std::chrono::system_clock::now();
+        for (size_t i = 0; i < readCount; ++i) {
+            sum += vol.GetDataBlock(dist(rng)).Buf().Data()[0];
+        }
+        auto finish = std::chrono::system_clock::now();
+        const std::chrono::duration<double> elapsed_seconds = finish - start;
+
+        const auto after = vol.GetCacheStats();
+        const size_t hits = after.Hits - before.Hits;
+        const size_t misses = after.Misses - before.Misses;
+        std::cerr << "workingSet: " << workingSet
+            << " (" << (workingSet * 100 / capacity) << "% of cache)"
+            << ", reads/sec: " << size_t(readCount / elapsed_seconds.count())
+            << ", hitRatio: " << (hits * 1.0 / (hits + misses))
+            << ", evictions: " << (after.Evictions - before.Evictions)
+            << ", dirtySkips: " << (after.DirtySkips - before.DirtySkips)
+            << ", checksum: " << sum
+            << '\n';
+    }
+}
+
+// Many threads hitting small hot set (like inode table blocks), 1 shard vs many
+void BenchBlockCacheShards() {
+    using namespace NJK;
+
+    const std::string filePath = "./var/bench_block_cache_shards";
+    const size_t blockCount = 1024;
+    const size_t threadCount = 64;
+    const size_t readCount = 200000;
+
+    std::filesystem::create_directories("./var");
+    std::filesystem::remove(filePath);
+    TBlockDirectIoFile raw(filePath, 4096);
+    raw.TruncateInBlocks(blockCount);
+
+    for (size_t shards : {1, 4, 16, 64}) {
+        TCachedBlockFile::TSettings settings;
+        settings.Capacity = 64 * 1024;
+        settings.Shards = shards;
+        TCachedBlockFile cached(raw, settings);
+        for (size_t i = 0; i < blockCount; ++i) {
+            cached.GetBlock(i);
+        }
+
+        std::vector<std::thread> threads;
+        auto start = std::chrono::system_clock::now();
+        for (size_t t = 0; t < threadCount; ++t) {
+            threads.emplace_back([&cached, t] {
+                std::mt19937 rng(t);
+                std::uniform_int_distribution<size_t> dist(0, blockCount - 1);
+                for (size_t i = 0; i < readCount; ++i) {
+                    cached.GetBlock(dist(rng));
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        auto finish = std::chrono::system_clock::now();
+        const std::chrono::duration<double> elapsed_seconds = finish - start;
+
+        std::cerr << "shards: " << cached.GetShardCount()
+            << ", reads/sec: " << size_t(threadCount * readCount / elapsed_seconds.count())
+            << '\n';
+    }
+}
+
+// Full tree dump of cold volume with and without sequential readahead
+void BenchDumpTree() {
+    using namespace NJK;
+
+    const std::string volumePath = "./var/volume_bench_dump";
+    const size_t dirCount = 100;
+    const size_t keyCount = 100;
+
+    std::filesystem::remove_all(volumePath);
+    {
+        TVolume vol(volumePath, {}, false);
+        TInodeDataOps ops(&vol);
+        auto root = vol.AllocateInode();
+        for (size_t i = 0; i < dirCount; ++i) {
+            auto dir = ops.AddChild(root, "dir_" + std::to_string(i));
+            for (size_t j = 0; j < keyCount; ++j) {
+                auto key = ops.AddChild(dir, "key_" + std::to_string(j));
+                ops.SetValue(key, (ui32)(i * keyCount + j));
+            }
+        }
+    }
+
+    for (ui32 readahead : {0, 64}) {
+        TVolume::TSettings settings;
+        settings.ReadaheadBlocks = readahead;
+        TVolume vol(volumePath, settings, false);
+        TInodeDataOps ops(&vol);
+
+        std::stringstream out;
+        auto start = std::chrono::system_clock::now();
+        ops.DumpTree(out);
+        auto finish = std::chrono::system_clock::now();
+        const std::chrono::duration<double> elapsed_seconds = finish - start;
+
+        const auto stats = vol.GetCacheStats();
+        std::cerr << "readahead: " << readahead
+            << ", elapsed: " << elapsed_seconds.count()
+            << ", misses: " << stats.Misses
+            << ", prefetched: " << stats.Prefetched
+            << ", prefetchHits: " << stats.PrefetchHits
+            << ", reads: " << stats.Reads
+            << ", dumpSize: " << out.str().size()
+            << '\n';
+    }
+}
+
+// Lookups in directories of one full leaf block, hits and misses
+void BenchDirectoryLookup() {
+    using namespace NJK;
+
+    const std::string volumePath = "./var/volume_bench_dir_lookup";
+    const size_t lookupCount = 2000000;
+    std::filesystem::remove_all(volumePath);
+
+    TVolume vol(volumePath, {}, false);
+    TInodeDataOps ops(&vol);
+    auto root = vol.AllocateInode();
+
+    for (const size_t nameLen : {8, 16, 32}) {
+        auto dir = ops.AddChild(root, "dir_" + std::to_string(nameLen));
+        std::vector<std::string> names;
+        // Same length names, the worst case for length check
+        while (true) {
+            auto name = std::to_string(names.size());
+            name = std::string(nameLen - name.size(), 'k') + name;
+            ops.AddChild(dir, name);
+            if (dir.Dir.IndexLevels) {
+                ops.RemoveChild(dir, name);
+                break;
+            }
+            names.push_back(std::move(name));
+        }
+
+        for (const bool hit : {true, false}) {
+            std::mt19937 rnd(42);
+            size_t found = 0;
+            auto start = std::chrono::system_clock::now();
+            for (size_t i = 0; i < lookupCount; ++i) {
+                auto name = names[rnd() % names.size()];
+                if (!hit) {
+                    name.back() = 'x';
+                }
+                found += ops.LookupChild(dir, name).has_value();
+            }
+            const std::chrono::duration<double> elapsed = std::chrono::system_clock::now() - start;
+            Y_ENSURE(found == (hit ? lookupCount : 0));
+            std::cerr << "name len: " << nameLen
+                << ", entries: " << names.size()
+                << ", " << (hit ? "hit" : "miss")
+                << ", ns per lookup: " << elapsed.count() * 1e9 / lookupCount << '\n';
+        }
+    }
+}
+
+// TDirLeafBlock::Find in one leaf of 8, 64 and 256 random names
+void BenchDirLeafLookup() {
+    using namespace NJK;
+    using NVolume::TDirLeafBlock;
+
+    const size_t lookupCount = 10000000;
+    std::mt19937 rnd(42);
+
+    for (const size_t count : {8, 64, 256}) {
+        auto buf = TFixedBuffer::Aligned(4096);
+        TDirLeafBlock::Init(buf);
+        std::vector<std::string> names;
+        while (names.size() < count) {
+            auto name = "k" + std::to_string(rnd() % 1000000);
+            if (TDirLeafBlock::Find(buf, name)) {
+                continue;
+            }
+            Y_ENSURE(TDirLeafBlock::Insert(buf, names.size(), name));
+            names.push_back(std::move(name));
+        }
+
+        for (const bool hit : {true, false}) {
+            size_t found = 0;
+            auto start = std::chrono::system_clock::now();
+            for (size_t i = 0; i < lookupCount; ++i) {
+                const size_t idx = rnd() % count;
+                std::string_view name = names[idx];
+                if (!hit) {
+                    name.remove_suffix(1);
+                }
+                found += TDirLeafBlock::Find(buf, name).has_value();
+            }
+            const std::chrono::duration<double> elapsed = std::chrono::system_clock::now() - start;
+            Y_ENSURE(found == (hit ? lookupCount : 0));
+            std::cerr << "entries: " << count
+                << ", " << (hit ? "hit" : "miss")
+                << ", ns per lookup: " << elapsed.count() * 1e9 / lookupCount << '\n';
+        }
+    }
+}
+
+// Children of one directory: inserts, then cold lookups of random ones
+void BenchBigDirectory(size_t childCount) {
+    using namespace NJK;
+
+    const std::string volumePath = "./var/volume_bench_big_directory";
+    const size_t lookupCount = 100000;
+    std::filesystem::remove_all(volumePath);
+
+    auto name = [](size_t i) {
+        return "user_" + std::to_string(i);
+    };
+
+    {
+        TVolume vol(volumePath, {}, false);
+        TInodeDataOps ops(&vol);
+        auto root = vol.AllocateInode();
+        auto dir = ops.AddChild(root, "users");
+
+        auto start = std::chrono::system_clock::now();
+        for (size_t i = 0; i < childCount; ++i) {
+            ops.AddChild(dir, name(i));
+            if ((i + 1) % 1000000 == 0) {
+                const std::chrono::duration<double> elapsed = std::chrono::system_clock::now() - start;
+                std::cerr << "inserted: " << i + 1 << ", elapsed: " << elapsed.count() << '\n';
+            }
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::system_clock::now() - start;
+        std::cerr << "insert rps: " << childCount / elapsed.count()
+            << ", index levels: " << (int)dir.Dir.IndexLevels << '\n';
+    }
+
+    TVolume vol(volumePath, {}, false);
+    TInodeDataOps ops(&vol);
+    auto root = vol.ReadInode(0);
+    auto dir = *ops.LookupChild(root, "users");
+
+    std::mt19937 rnd(42);
+    const size_t reads = vol.GetCacheStats().Reads;
+    auto start = std::chrono::system_clock::now();
+    for (size_t i = 0; i < lookupCount; ++i) {
+        Y_ENSURE(ops.LookupChild(dir, name(rnd() % childCount)));
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::system_clock::now() - start;
+    std::cerr << "lookup rps: " << lookupCount / elapsed.count()
+        << ", reads per lookup: " << double(vol.GetCacheStats().Reads - reads) / lookupCount << '\n';
+}
+
+// Concurrent inode and data block allocation, and Set of new keys, 1-8 threads
+void BenchAllocation() {
+    using namespace NJK;
+
+    const size_t opCount = 400000;
+    const size_t keyCount = 100000;
+    const size_t batch = 100;
+
+    for (size_t threadCount : {1, 2, 4, 8}) {
+        {
+            VOLUME_PATH(alloc);
+            VOLUME(alloc);
+            auto start = std::chrono::system_clock::now();
+            std::vector<std::thread> threads;
+            for (size_t t = 0; t < threadCount; ++t) {
+                threads.emplace_back([&] {
+                    std::vector<TVolume::TInode> inodes;
+                    std::vector<ui32> blocks;
+                    for (size_t i = 0; i < opCount / threadCount / batch; ++i) {
+                        for (size_t j = 0; j < batch; ++j) {
+                            inodes.push_back(alloc.AllocateInode());
+                            blocks.push_back(alloc.AllocateDataBlock());
+                        }
+                        for (size_t j = 0; j < batch; ++j) {
+                            alloc.DeallocateInode(inodes[j]);
+                            alloc.DeallocateDataBlock(blocks[j]);
+                        }
+                        inodes.clear();
+                        blocks.clear();
+                    }
+                });
+            }
+            for (auto& t : threads) {
+                t.join();
+            }
+            const std::chrono::duration<double> elapsed = std::chrono::system_clock::now() - start;
+            std::cerr << "threads: " << threadCount
+                << ", allocations/sec: " << size_t(opCount * 2 / elapsed.count())
+                << '\n';
+        }
+
+        {
+            VOLUME_PATH(keys);
+            VOLUME(keys);
+            auto s = TStorageBuilder(&keys).Build();
+            auto start = std::chrono::system_clock::now();
+            std::vector<std::thread> threads;
+            for (size_t t = 0; t < threadCount; ++t) {
+                threads.emplace_back([&, t] {
+                    const std::string dir = "/thread_" + std::to_string(t) + "/key_";
+                    for (size_t i = 0; i < keyCount / threadCount; ++i) {
+                        s.Set(dir + std::to_string(i), (ui32)i);
+                    }
+                });
+            }
+            for (auto& t : threads) {
+                t.join();
+            }
+            const std::chrono::duration<double> elapsed = std::chrono::system_clock::now() - start;
+            std::cerr << "threads: " << threadCount
+                << ", new keys/sec: " << size_t(keyCount / elapsed.count())
+                << '\n';
+        }
+    }
+}
+
+// Random 4 KiB O_DIRECT reads: sync pread vs io_uring at QD1 and QD32
+void BenchDirectIoQueue() {
+    using namespace NJK;
+
+    const std::string filePath = "./var/bench_direct_io_queue";
+    const size_t blockCount = 64_MiB / 4096;
+    const size_t readCount = 50000;
+    {
+        std::filesystem::create_directories("./var");
+        std::filesystem::remove(filePath);
+        TBlockDirectIoFile raw(filePath, 4096);
+        raw.TruncateInBlocks(blockCount);
+        auto buf = TFixedBuffer::Aligned(4096);
+        buf.FillZeroes();
+        for (size_t i = 0; i < blockCount; ++i) {
+            raw.WriteBlock(buf, i);
+        }
+    }
+
+    TDirectIoFile file(filePath);
+
+    auto report = [&](const std::string& name, auto&& run) {
+        std::mt19937 rng(0);
+        std::uniform_int_distribution<size_t> dist(0, blockCount - 1);
+        auto start = std::chrono::system_clock::now();
+        run([&] { return dist(rng) * 4096; });
+        auto finish = std::chrono::system_clock::now();
+        const std::chrono::duration<double> elapsed_seconds = finish - start;
+        std::cerr << name
+            << ": IOPS " << size_t(readCount / elapsed_seconds.count())
+            << ", MiB/s " << (readCount * 4096 / elapsed_seconds.count() / 1_MiB)
+            << '\n';
+    };
+
+    report("sync pread QD1", [&](auto&& nextOffset) {
+        auto buf = TFixedBuffer::Aligned(4096);
+        for (size_t i = 0; i < readCount; ++i) {
+            file.Read(buf.MutableData(), 4096, nextOffset());
+        }
+    });
+
+    for (size_t depth : {1, 32}) {
+        TDirectIoQueue queue(depth);
+        if (!queue.IsAsync()) {
+            std::cerr << "io_uring is not supported, fallback to sync I/O\n";
+        }
+
+        std::vector<TFixedBuffer> bufs;
+        std::vector<TFixedBuffer*> bufPtrs;
+        for (size_t i = 0; i < depth; ++i) {
+            bufs.push_back(TFixedBuffer::Aligned(4096));
+        }
+        for (auto& buf : bufs) {
+            bufPtrs.push_back(&buf);
+        }
+        const bool fixed = queue.RegisterBuffers(bufPtrs);
+
+        std::stringstream name;
+        name << "io_uring QD" << depth << (fixed ? " registered buffers" : "");
+        report(name.str(), [&](auto&& nextOffset) {
+            std::vector<TDirectIoQueue::TCompletion> completions;
+            std::vector<size_t> freeBufs;
+            for (size_t i = 0; i < depth; ++i) {
+                freeBufs.push_back(i);
+            }
+            for (size_t i = 0; i < readCount; ++i) {
+                if (freeBufs.empty()) {
+                    queue.Wait(1, completions);
+                    for (const auto& c : completions) {
+                        Y_ENSURE(c.Result == 4096);
+                        freeBufs.push_back(c.Cookie);
+                    }
+                }
+                const size_t bufIdx = freeBufs.back();
+                freeBufs.pop_back();
+                queue.Read(file, bufs[bufIdx].MutableData(), 4096, nextOffset(), bufIdx, fixed ? bufIdx : -1);
+            }
+            queue.Wait(queue.GetInFlight(), completions);
+        });
+    }
+}
+
 void TestBlockBitSet() {
     using namespace NJK;
 
     TBlockBitSet s(TFixedBuffer::Aligned(4096));
+    s.Buf().FillZeroes();
 
     assert(s.FindUnset() == 0);
     assert(s.Test(0) == false);
@@ -964,36 +3032,214 @@ void TestBlockBitSet() {
     assert(s.Test(0) == true);
     assert(s.Test(1) == true);
     assert(s.Test(2) == false);
+
+    // Lowest unset bit, also after the hint moved past full words
+    for (size_t i = 2; i < 200; ++i) {
+        assert(s.TrySetBit() == (i32)i);
+    }
+    s.Unset(70);
+    s.Unset(5);
+    assert(s.TrySetBit() == 5);
+    assert(s.TrySetBit() == 70);
+    assert(s.TrySetBit() == 200);
+
+    // Ranges across words, skipping set bits
+    s.Unset(100);
+    s.Unset(101);
+    assert(s.TrySetRange(3) == 201);
+    assert(s.TrySetRange(2) == 100);
+    assert(s.TrySetRange(100) == 204);
+    assert(s.Test(303) && !s.Test(304));
+    assert(s.FindUnset() == 304);
+
+    const size_t bitCount = 4096 * 8;
+    assert(s.TrySetRange(bitCount) == -1);
+    assert(s.TrySetRange(bitCount - 304) == 304);
+    assert(s.TrySetBit() == -1);
+    assert(s.FindUnset() == -1);
+
+    TFixedBuffer copy = TFixedBuffer::Aligned(4096);
+    s.CopyTo(copy);
+    assert(std::memcmp(copy.Data(), s.Buf().Data(), 4096) == 0);
+}
+
+void TestBlockBitSetConcurrency() {
+    using namespace NJK;
+
+    const size_t bitCount = 4096 * 8;
+    const size_t threadCount = 8;
+
+    TBlockBitSet s(TFixedBuffer::Aligned(4096));
+    s.Buf().FillZeroes();
+
+    // Every bit is set exactly once, while others are unset and set again
+    std::vector<std::vector<i32>> allocated(threadCount);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t] {
+            auto& my = allocated[t];
+            for (size_t i = 0; i < bitCount / threadCount; ++i) {
+                const i32 idx = i % 16 == 15 ? s.TrySetRange(1) : s.TrySetBit();
+                assert(idx != -1);
+                my.push_back(idx);
+                if (i % 4 == 3) {
+                    const i32 prev = my[my.size() - 2];
+                    s.Unset(prev);
+                    my[my.size() - 2] = s.TrySetBit();
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    std::vector<bool> seen(bitCount);
+    for (const auto& my : allocated) {
+        for (i32 idx : my) {
+            assert(idx >= 0 && (size_t)idx < bitCount);
+            assert(!seen[idx]);
+            seen[idx] = true;
+        }
+    }
+    assert(s.TrySetBit() == -1);
+}
+
+void TestBlockGroupConcurrentAllocation() {
+    using namespace NJK;
+
+    const std::string filePath = "./var/block_group_allocation";
+    const size_t threadCount = 8;
+    const size_t iterCount = 2000;
+
+    std::filesystem::create_directories("./var");
+    std::filesystem::remove(filePath);
+
+    const auto sb = TVolume::CalcSuperBlock({});
+    TBlockDirectIoFile raw(filePath, sb.BlockSize);
+    raw.TruncateInBlocks(2); // zeroed bitmaps
+    TCachedBlockFile cached(raw);
+
+    NVolume::TBlockGroupDescr descr;
+    descr.D.FreeInodeCount = sb.BlockGroupInodeCount;
+    descr.D.FreeDataBlockCount = sb.BlockGroupDataBlockCount;
+    NVolume::TBlockGroup bg(0, 0, cached, sb, descr);
+
+    // Singles and ranges, some are kept till the end
+    std::vector<size_t> kept(threadCount);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t] {
+            for (size_t i = 0; i < iterCount; ++i) {
+                const i32 single = bg.TryAllocateDataBlock();
+                const i32 range = bg.TryAllocateDataBlocks(3);
+                assert(single != -1 && range != -1);
+                bg.DeallocateDataBlock(range + 1);
+                if (i % 2) {
+                    bg.DeallocateDataBlock(single);
+                    bg.DeallocateDataBlock(range);
+                    bg.DeallocateDataBlock(range + 2);
+                } else {
+                    kept[t] += 3;
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    bg.Flush();
+    const auto bitmap = cached.GetBlock(NVolume::TBlockGroup::DataBlocksBitmapBlockIndex);
+    size_t used = 0;
+    for (size_t i = 0; i < sb.BlockSize; i += sizeof(ui64)) {
+        ui64 word = 0;
+        std::memcpy(&word, bitmap.Buf().Data() + i, sizeof(word));
+        used += std::popcount(word);
+    }
+    assert(used == std::accumulate(kept.begin(), kept.end(), size_t{0}));
+    assert(bg.GetFreeDataBlockCount() + used == sb.BlockGroupDataBlockCount);
 }
 
 int main(int argc, char** argv) {
     using namespace NJK;
 
-    Y_ENSURE(argc == 2);
+    Y_ENSURE(argc == 2 || argc == 3);
     const std::string mode(argv[1]);
 
     if (mode == "tests") {
         TestDefaultSuperBlockCalc();
         TestSuperBlockSerialization();
+        TestVolumeFormatVersion();
 
         CheckOnDiskSize<TVolume::TSuperBlock>();
         CheckOnDiskSize<TVolume::TInode>();
         CheckOnDiskSize<NVolume::TBlockGroupDescr>();
 
+        TestBlockBitSet();
+        TestBlockBitSetConcurrency();
+        TestBlockGroupConcurrentAllocation();
+        TestMetaGroupFailedScan();
         TestInodeAllocation();
         TestDataBlockAllocation();
+        TestBlockCacheEviction();
+        TestBlockCacheShards();
+        TestBlockCacheWriteBack();
+        TestBlockCacheWriteFailure();
+        TestDirectIoQueue();
+        TestVectoredBlockIo();
+        TestBlockCacheReadahead();
+        TestDirLeafBlock();
         TestInodeDataOps();
+        TestInodeBigValues();
+        TestInodeBigDirectory();
 
         TestStorage0();
         TestStorage1();
         TestStorageNonRoot();
+        TestStoragePathCache();
+        TestStorageConcurrentValue();
+        TestStorageDentryEviction();
+        TestStorageMultiGetSet();
+        TestStorageAtomicUpdate();
+
+        TestAdaptiveLock();
+        TestHashMapConcurrentInsert();
+        TestHashMapErase();
+        TestHashMapHeterogeneousLookup();
     } else if (mode == "increment") {
         TestConcurrencyIncrement();
     } else if (mode == "hashmap") {
         //TestHashMap();
         TestHashMapConcurrency();
+    } else if (mode == "hashmap_contention") {
+        BenchHashMapContention();
+    } else if (mode == "hashmap_layout") {
+        BenchHashMapLayout(argc == 3 ? std::stoull(argv[2]) : 1000000);
     } else if (mode == "setters_getters") {
         TestConcurrencySeparateSettersGetters();
+    } else if (mode == "cache") {
+        BenchBlockCache();
+    } else if (mode == "aio") {
+        BenchDirectIoQueue();
+    } else if (mode == "shards") {
+        BenchBlockCacheShards();
+    } else if (mode == "locks") {
+        BenchLocks();
+    } else if (mode == "path_cache") {
+        BenchPathCache();
+    } else if (mode == "bulk") {
+        BenchMultiGetSet();
+    } else if (mode == "dump") {
+        BenchDumpTree();
+    } else if (mode == "dir_lookup") {
+        BenchDirectoryLookup();
+    } else if (mode == "leaf_lookup") {
+        BenchDirLeafLookup();
+    } else if (mode == "big_dir") {
+        BenchBigDirectory(argc == 3 ? std::stoull(argv[2]) : 10000000);
+    } else if (mode == "alloc") {
+        BenchAllocation();
     } else {
         Y_FAIL("");
     } 
@@ -1,9 +1,13 @@
 #include "storage.h"
 #include "hash_map.h"
+#include "epoch.h"
 #include "volume.h"
 #include "volume/ops.h"
 
+#include <algorithm>
+#include <deque>
 #include <stack>
+#include <optional>
 #include <cassert>
 #include <string_view>
 #include <sstream>
@@ -47,6 +51,37 @@ namespace NJK {
             return node.Dentry->GetValue();
         }
 
+        void MultiSet(std::span<const std::pair<std::string, TValue>> items, ui32 deadline) {
+            std::vector<const std::string*> paths;
+            paths.reserve(items.size());
+            for (const auto& item : items) {
+                paths.push_back(&item.first);
+            }
+
+            auto nodes = ResolvePaths(paths, true);
+            for (size_t i = 0; i < items.size(); ++i) {
+                Y_VERIFY(nodes[i].Dentry);
+                nodes[i].Dentry->SetValue(items[i].second, deadline);
+            }
+        }
+
+        std::vector<TValue> MultiGet(std::span<const std::string> paths) {
+            std::vector<const std::string*> ptrs;
+            ptrs.reserve(paths.size());
+            for (const auto& path : paths) {
+                ptrs.push_back(&path);
+            }
+
+            auto nodes = ResolvePaths(ptrs, false);
+            std::vector<TValue> ret(paths.size());
+            for (size_t i = 0; i < paths.size(); ++i) {
+                if (nodes[i].Dentry) {
+                    ret[i] = nodes[i].Dentry->GetValue();
+                }
+            }
+            return ret;
+        }
+
         void Erase(const std::string& path) {
             auto node = ResolvePath(path, false);
             if (!node.Dentry) {
@@ -55,14 +90,64 @@ namespace NJK {
             return node.Dentry->UnsetValue();
         }
 
+        TValue Update(const std::string& path, const TUpdateFunc& fn, ui32 deadline) {
+            auto node = ResolvePath(path, true);
+            Y_VERIFY(node.Dentry);
+            return node.Dentry->UpdateValue(fn, deadline);
+        }
+
+        ui32 Increment(const std::string& path, ui32 delta) {
+            auto node = ResolvePath(path, true);
+            Y_VERIFY(node.Dentry);
+            const auto prev = node.Dentry->UpdateValue([delta](const TValue& cur) -> std::optional<TValue> {
+                if (std::holds_alternative<std::monostate>(cur)) {
+                    return delta;
+                }
+                if (const auto* num = std::get_if<ui32>(&cur)) {
+                    return *num + delta;
+                }
+                throw std::runtime_error("Increment of non-ui32 value");
+            }, std::nullopt);
+            return std::holds_alternative<ui32>(prev) ? std::get<ui32>(prev) + delta : delta;
+        }
+
+        bool CompareAndSet(const std::string& path, const TValue& expected, const TValue& desired, ui32 deadline) {
+            auto node = ResolvePath(path, std::holds_alternative<std::monostate>(expected));
+            if (!node.Dentry) {
+                return false;
+            }
+            bool swapped = false;
+            node.Dentry->UpdateValue([&](const TValue& cur) -> std::optional<TValue> {
+                swapped = cur == expected;
+                if (!swapped) {
+                    return std::nullopt;
+                }
+                return desired;
+            }, deadline);
+            return swapped;
+        }
+
         void Mount(const std::string& mountPointPath, TVolume* srcVolume, const std::string& srcDir);
 
+        void EnablePathCache() {
+            PathCache_ = std::make_unique<TPathCache>();
+        }
+
+        void SetDentryCacheSettings(const TDentryCacheSettings& settings) {
+            DentryCacheSettings_ = settings;
+        }
+
+        TDentryCacheStats GetDentryCacheStats();
+
     private:
         struct TDentry;
 
         struct TResolveParams {
             bool Create = false;
             bool MergeIntermediate = false;
+            // Already looked up or created in parent directory, StepPath
+            // reads inode by id instead of searching directory again
+            std::optional<TInode::TId> ChildInodeId;
         };
 
         struct TFullInodeId {
@@ -91,7 +176,7 @@ namespace NJK {
 
         class TChildNameLockGuard {
         public:
-            TChildNameLockGuard(TDentry* dentry, std::string name);
+            TChildNameLockGuard(TDentry* dentry, std::string_view name);
             TChildNameLockGuard(TChildNameLockGuard&) = delete;
             TChildNameLockGuard(TChildNameLockGuard&&) noexcept;
             ~TChildNameLockGuard();
@@ -99,7 +184,7 @@ namespace NJK {
             TChildNameLockGuard& operator= (const TChildNameLockGuard&) = delete;
             TChildNameLockGuard& operator= (TChildNameLockGuard&&) noexcept;
 
-            const std::string& Name() const {
+            std::string_view Name() const {
                 return Name_;
             }
 
@@ -111,11 +196,11 @@ namespace NJK {
 
         private:
             TDentry* Dentry_{};
-            std::string Name_;
+            std::string_view Name_; // points into the resolved path
         };
 
         struct TDentry {
-            enum class EState {
+            enum class EState: ui8 {
                 Uninitialized,
                 Exists,
                 NotExists,
@@ -123,65 +208,71 @@ namespace NJK {
                 
             static constexpr const size_t MaxLocalValueSize = 128; // TODO
 
-            TNaiveSpinLock Lock;
+            // Immutable, replaced as a whole by writers and freed through TEpoch
+            struct TValueSnapshot {
+                TValue Value;
+                ui32 Deadline = 0;
+            };
 
-            EState State = EState::Uninitialized;
-            TCondVar InitCondVar;
-            std::atomic<size_t> Initialized{0};
+            TDentry() = default;
 
-            bool CreateLocked = false;
-            TCondVar CreateCondVar;
+            ~TDentry() {
+                delete LocalValue.load(std::memory_order::relaxed);
+            }
+
+            // There are tens of millions of them, so keep it small. Name is
+            // not here, it's in TDentryCacheKey already.
 
-            size_t DirReadLocked = 0;
+            TAdaptiveLock Lock;
+            // One futex word for every wait below: waiters re-check their
+            // condition in a loop, whoever changes any of them notifies all
+            TCondVar Changed;
+
+            EState State = EState::Uninitialized;
+            std::atomic<ui8> Initialized{0};
+            std::atomic<bool> Referenced{false}; // since it was looked at by eviction
+            bool CreateLocked = false;
             // Serialize concurrent directory structure modification
             // TODO DirWriteLocked is to slow if we wait each modification to disk write
             bool DirWriteLocked = false;
-            TCondVar DirWriteUnlockedCondVar;
-
-            size_t ValueReadLocked = 0;
-            size_t ValueWriteLocked = 0;
-            TCondVar ValueWriteUnlockedCondVar;
+            bool ValueWriteLocked = false;
+            ui32 DirReadLocked = 0;
+            ui32 ValueReadLocked = 0;
 
             // Prevent from Exists to NotExists
-            size_t PreventRemoval = 0;
-            TCondVar PreventRemovalCondVar;
+            ui32 PreventRemoval = 0;
 
             TVolume* Volume{};
 
-            //TDentry* Parent{};
-            std::string InParentName; // for debug
-
-            std::vector<std::string> ChildrenLocks;
-            TCondVar ChildrenLocksCondVar;
-
-            //TInode::TId InodeId{};
-            std::unique_ptr<TInode> Inode;
-            std::optional<TValue> LocalValue;
-            ui32 LocalDeadline = 0;
+            std::optional<TInode> Inode;
+            // nullptr if value is on disk only. Readers load it without locks,
+            // writers replace it under LockValueForWrite, UpdateValue by CAS
+            std::atomic<TValueSnapshot*> LocalValue{nullptr};
 
             std::unique_ptr<std::vector<TMount>> Mounts;
 
-            [[nodiscard]] TLockGuard<TNaiveSpinLock> LockGuard();
+            [[nodiscard]] TLockGuard<TAdaptiveLock> LockGuard();
 
             void WaitInitialized();
 
             // returns guard
-            [[nodiscard]] TChildNameLockGuard LockChild(const std::string& name);
-            void UnlockChild(const std::string& name);
+            [[nodiscard]] TChildNameLockGuard LockChild(std::string_view name);
+            void UnlockChild(std::string_view name);
 
-            std::unique_ptr<TInode> EnsureChild(const std::string& name, const TChildNameLockGuard& g);
-            std::unique_ptr<TInode> LookupChild(const std::string& name, const TChildNameLockGuard& g);
+            std::optional<TInode> EnsureChild(const std::string& name, const TChildNameLockGuard& g);
+            std::optional<TInode> LookupChild(const std::string& name, const TChildNameLockGuard& g);
+            // Under one directory write lock, returns ids in the same order
+            std::vector<TInode::TId> EnsureChildren(const std::vector<std::string>& names);
 
             /////////////////////////////////////////////////////////////////
             TODO("1. Combine Dir and Value in TInode.Data")
-            TODO("2. Don't RdWrLock all this. Write Dir/Value in new Data Blocks and then replace")
-            TODO("3. Store small TValue in TDentry itself")
+            TODO("2. Don't RdWrLock Dir. Write it in new Data Blocks and then replace")
             /////////////////////////////////////////////////////////////////
 
             void LockDirForRead() {
                 auto g = LockGuard();
                 while (DirWriteLocked) {
-                    DirWriteUnlockedCondVar.Wait(Lock);
+                    Changed.Wait(Lock);
                 }
                 ++DirReadLocked;
             }
@@ -194,7 +285,7 @@ namespace NJK {
                         notify = true;
                     }
                 }
-                DirWriteUnlockedCondVar.NotifyAll(); // FIXME
+                Changed.NotifyAll(); // FIXME
             }
 
             void LockDirForWrite() {
@@ -202,7 +293,7 @@ namespace NJK {
 
                 auto g = LockGuard();
                 while (DirReadLocked || DirWriteLocked) {
-                    DirWriteUnlockedCondVar.Wait(Lock);
+                    Changed.Wait(Lock);
                 }
                 DirWriteLocked = true;
             }
@@ -212,7 +303,7 @@ namespace NJK {
                     auto g = LockGuard();
                     DirWriteLocked = false;
                 }
-                DirWriteUnlockedCondVar.NotifyAll(); // FIXME
+                Changed.NotifyAll(); // FIXME
             }
 
             /////////////////////////////////////////////////////////////////
@@ -220,7 +311,7 @@ namespace NJK {
             void LockValueForRead() {
                 auto g = LockGuard();
                 while (ValueWriteLocked) {
-                    ValueWriteUnlockedCondVar.Wait(Lock);
+                    Changed.Wait(Lock);
                 }
                 ++ValueReadLocked;
             }
@@ -233,7 +324,7 @@ namespace NJK {
                         notify = true;
                     }
                 }
-                ValueWriteUnlockedCondVar.NotifyAll(); // FIXME
+                Changed.NotifyAll(); // FIXME
             }
 
             void LockValueForWrite() {
@@ -241,7 +332,7 @@ namespace NJK {
 
                 auto g = LockGuard();
                 while (ValueReadLocked || ValueWriteLocked) {
-                    ValueWriteUnlockedCondVar.Wait(Lock);
+                    Changed.Wait(Lock);
                 }
                 ValueWriteLocked = true;
             }
@@ -251,7 +342,7 @@ namespace NJK {
                     auto g = LockGuard();
                     ValueWriteLocked = false;
                 }
-                ValueWriteUnlockedCondVar.NotifyAll(); // FIXME
+                Changed.NotifyAll(); // FIXME
             }
 
             /////////////////////////////////////////////////////////////////
@@ -259,9 +350,40 @@ namespace NJK {
             void Flush() {
                 TODO_BETTER_CONCURRENCY
                 auto g = LockGuard();
-                if (LocalValue) {
+                if (auto* local = LocalValue.load(std::memory_order::acquire)) {
                     TInodeDataOps ops(Volume);
-                    ops.SetValue(*Inode, *LocalValue, LocalDeadline);
+                    ops.SetValue(*Inode, local->Value, local->Deadline);
+                }
+            }
+
+            // Writes local value and drops it, so the dentry is clean. Fails
+            // if value writer is busy or the value was replaced meanwhile
+            bool TryFlushForEviction() {
+                TODO_BETTER_CONCURRENCY
+                auto g = LockGuard();
+                // Locked writers need Lock to start, lock-free ones fail our CAS
+                if (ValueWriteLocked) {
+                    return false;
+                }
+                TEpochGuard guard;
+                auto* local = LocalValue.load(std::memory_order::acquire);
+                if (!local) {
+                    return true;
+                }
+                TInodeDataOps ops(Volume);
+                ops.SetValue(*Inode, local->Value, local->Deadline);
+                // On failure disk may have our value, but the local one overrides it
+                if (!LocalValue.compare_exchange_strong(local, nullptr, std::memory_order::acq_rel, std::memory_order::acquire)) {
+                    return false;
+                }
+                TEpoch::Retire(local);
+                return true;
+            }
+
+            // Under LockValueForWrite
+            void PublishValue(TValueSnapshot* local) {
+                if (auto* prev = LocalValue.exchange(local, std::memory_order::acq_rel)) {
+                    TEpoch::Retire(prev);
                 }
             }
 
@@ -271,14 +393,16 @@ namespace NJK {
                     UnlockValueForWrite();
                 });
 
-                TODO_BETTER_CONCURRENCY
-                auto g = LockGuard();
-                if (auto* str = std::get_if<std::string>(&value); str && str->size() > MaxLocalValueSize) {
-                    TInodeDataOps ops(Volume);
-                    ops.SetValue(*Inode, value, deadline);
+                if (!IsLocal(value)) {
+                    {
+                        TODO_BETTER_CONCURRENCY
+                        auto g = LockGuard();
+                        TInodeDataOps ops(Volume);
+                        ops.SetValue(*Inode, value, deadline);
+                    }
+                    PublishValue(nullptr);
                 } else {
-                    LocalValue = value;
-                    LocalDeadline = deadline;
+                    PublishValue(new TValueSnapshot{value, deadline});
                 }
             }
 
@@ -288,30 +412,137 @@ namespace NJK {
                     UnlockValueForWrite();
                 });
 
-                TODO_BETTER_CONCURRENCY
-                auto g = LockGuard();
-                LocalValue = TValue{};
-                LocalDeadline = 0;
+                PublishValue(new TValueSnapshot{});
+            }
+
+            static bool IsLocal(const TValue& value) {
+                const auto* str = std::get_if<std::string>(&value);
+                return !str || str->size() <= MaxLocalValueSize;
+            }
+
+            // Integers and other small values are replaced by CAS of
+            // snapshot without locks. Values on disk are read and written
+            // under LockValueForWrite, but still published by CAS: lock-free
+            // updaters don't take the lock. Empty deadline keeps current one.
+            template <typename F>
+            TValue UpdateValue(F&& fn, std::optional<ui32> deadline) {
+                {
+                    TEpochGuard guard;
+                    auto* local = LocalValue.load(std::memory_order::acquire);
+                    while (local) {
+                        std::optional<TValue> next = fn(local->Value);
+                        if (!next) {
+                            return local->Value;
+                        }
+                        if (!IsLocal(*next)) {
+                            break;
+                        }
+                        auto* snapshot = new TValueSnapshot{std::move(*next), deadline.value_or(local->Deadline)};
+                        if (LocalValue.compare_exchange_weak(local, snapshot, std::memory_order::acq_rel, std::memory_order::acquire)) {
+                            TValue prev = local->Value;
+                            TEpoch::Retire(local);
+                            return prev;
+                        }
+                        delete snapshot;
+                    }
+                }
+
+                LockValueForWrite();
+                Y_DEFER([this] {
+                    UnlockValueForWrite();
+                });
+
+                TEpochGuard guard;
+                auto* local = LocalValue.load(std::memory_order::acquire);
+                while (true) {
+                    // Nobody replaces nullptr while we hold the lock
+                    TValue cur;
+                    ui32 curDeadline = 0;
+                    if (local) {
+                        cur = local->Value;
+                        curDeadline = local->Deadline;
+                    } else {
+                        TODO_BETTER_CONCURRENCY
+                        auto g = LockGuard();
+                        TInodeDataOps ops(Volume);
+                        cur = ops.GetValue(*Inode);
+                        curDeadline = Inode->Val.Deadline;
+                    }
+
+                    std::optional<TValue> next = fn(cur);
+                    if (!next) {
+                        return cur;
+                    }
+
+                    const ui32 nextDeadline = deadline.value_or(curDeadline);
+                    TValueSnapshot* snapshot = nullptr;
+                    if (IsLocal(*next)) {
+                        snapshot = new TValueSnapshot{std::move(*next), nextDeadline};
+                    } else {
+                        TODO_BETTER_CONCURRENCY
+                        auto g = LockGuard();
+                        TInodeDataOps ops(Volume);
+                        ops.SetValue(*Inode, *next, nextDeadline);
+                    }
+
+                    // On failure disk may have our value, but the local one overrides it
+                    if (LocalValue.compare_exchange_strong(local, snapshot, std::memory_order::acq_rel, std::memory_order::acquire)) {
+                        if (local) {
+                            TEpoch::Retire(local);
+                        }
+                        return cur;
+                    }
+                    delete snapshot;
+                }
             }
 
             TValue GetValue() {
+                {
+                    TEpochGuard guard;
+                    if (auto* local = LocalValue.load(std::memory_order::acquire)) {
+                        return local->Value;
+                    }
+                }
+
                 LockValueForRead();
                 Y_DEFER([this] {
                     UnlockValueForRead();
                 });
 
+                // Could be published while we were waiting for writer
+                {
+                    TEpochGuard guard;
+                    if (auto* local = LocalValue.load(std::memory_order::acquire)) {
+                        return local->Value;
+                    }
+                }
+
                 TODO_BETTER_CONCURRENCY
                 auto g = LockGuard();
-                if (LocalValue) {
-                    return *LocalValue;
-                } else {
-                    TInodeDataOps ops(Volume);
-                    return ops.GetValue(*Inode);
-                }
+                TInodeDataOps ops(Volume);
+                return ops.GetValue(*Inode);
             }
         };
 
+        // For lookups without copying child name out of the path
+        struct TDentryCacheKeyView {
+            TFullInodeId ParentInode;
+            std::string_view ChildName;
+        };
+
         struct TDentryCacheKey {
+            TDentryCacheKey(TFullInodeId parentInode, std::string childName)
+                : ParentInode(parentInode)
+                , ChildName(std::move(childName))
+            {
+            }
+
+            explicit TDentryCacheKey(const TDentryCacheKeyView& view)
+                : ParentInode(view.ParentInode)
+                , ChildName(view.ChildName)
+            {
+            }
+
             TFullInodeId ParentInode;
             std::string ChildName;
 
@@ -319,6 +550,11 @@ namespace NJK {
                 return ParentInode == other.ParentInode
                     && ChildName == other.ChildName;
             }
+
+            bool operator== (const TDentryCacheKeyView& other) const {
+                return ParentInode == other.ParentInode
+                    && ChildName == other.ChildName;
+            }
         };
 
         struct TFullInodeIdHash {
@@ -330,9 +566,16 @@ namespace NJK {
         };
 
         struct TDentryKeyHash {
+            using is_transparent = void;
+
             size_t operator() (const TDentryCacheKey& key) const {
+                return (*this)(TDentryCacheKeyView{key.ParentInode, key.ChildName});
+            }
+
+            // Same as std::hash<std::string> for the same chars
+            size_t operator() (const TDentryCacheKeyView& key) const {
                 auto h0 = TFullInodeIdHash{}(key.ParentInode);
-                auto h1 = std::hash<std::string>{}(key.ChildName);
+                auto h1 = std::hash<std::string_view>{}(key.ChildName);
                 return CombineHashes(h0, h1);
             }
         };
@@ -388,6 +631,11 @@ namespace NJK {
                 PreventRemoval_ = true;
             }
 
+            // Empty for mounted dentries, they are not in cache
+            TDentryFromCache ShareHolder() const {
+                return Holder_.Share();
+            }
+
             TDentry* operator-> () const {
                 return Ptr_;
             }
@@ -425,22 +673,84 @@ namespace NJK {
             return TDentryWithGuards{std::move(dentry)};
         }
 
+        // Resolved path, valid while Generation is current. Only existing
+        // dentries are here: they never turn back to NotExists, so only
+        // Mount (which changes what path points to) invalidates it.
+        struct TPathCacheEntry {
+            TNaiveSpinLock Lock;
+            size_t Generation = 0;
+            TVolume* Volume{};
+            TDentryFromCache Dentry;
+        };
+
+        struct TPathHash {
+            using is_transparent = void;
+
+            size_t operator() (std::string_view path) const {
+                return std::hash<std::string_view>{}(path);
+            }
+        };
+
+        using TPathCache = THashMap<std::string, TPathCacheEntry, TPathHash>;
+
+        // Eviction is CLOCK over keys in order of insertion: referenced
+        // dentries get second chance, those that are held by someone are
+        // skipped. Negative dentries have their own queue, so scans for
+        // missing keys don't wash out existing ones.
+        struct TEvictionQueues {
+            std::mutex Lock;
+            std::deque<TDentryCacheKey> Dentries;
+            std::deque<TDentryCacheKey> NegativeDentries;
+            std::deque<std::string> Paths;
+        };
+
+        static void MarkReferenced(TDentry& dentry) {
+            if (!dentry.Referenced.load(std::memory_order::relaxed)) {
+                dentry.Referenced.store(true, std::memory_order::relaxed);
+            }
+        }
+
+        void OnDentryCreated(TDentryCacheKey key, bool negative);
+        void OnPathCached(std::string path);
+        void EvictDentries(bool negative);
+        void EvictPaths();
+
+        TDentryWithVolume LookupPathCache(const std::string& path);
+        void UpdatePathCache(const std::string& path, size_t generation, const TDentryWithVolume& node);
+        TDentryWithVolume ResolvePathUncached(const std::string& path, bool create);
+        TDentryWithVolume StepMounted(const TDentryWithVolume& dir, std::string_view childName, bool create);
+        // Keys of the same directory are resolved together: directory path
+        // is walked once and missing children are added with one rewrite
+        std::vector<TDentryWithVolume> ResolvePaths(const std::vector<const std::string*>& paths, bool create);
+
         TDentry* EnsureMountedInode(TVolume* srcVolume, const std::string& srcDir);
         TDentryWithVolume ResolvePath(const std::string& path, bool create);
         TDentryWithVolume ResolveDirs(const std::string_view& path, const TResolveParams&);
         TVolume::TInode ResolveInVolumePath(TVolume* volume, const std::string& path);
-        TDentryWithGuards StepPath(const TDentryWithVolume& parent, const std::string& childName, const TResolveParams&);
+        TDentryWithGuards StepPath(const TDentryWithVolume& parent, std::string_view childName, const TResolveParams&);
         void EnsureInodeData(TDentryWithVolume node);
 
     private:
         TMount Root_;
         TDentryCache DentryCache_;
         std::unordered_map<TFullInodeId, TDentry, TFullInodeIdHash> Mounted_;
+        std::vector<TDentryFromCache> MountPoints_; // pinned in DentryCache_
+
+        // Optional, holds dentries from DentryCache_, so goes after it
+        std::unique_ptr<TPathCache> PathCache_;
+        std::atomic<size_t> PathGeneration_{1};
+
+        TDentryCacheSettings DentryCacheSettings_;
+        TEvictionQueues Eviction_;
+        std::atomic<size_t> Evictions_{0};
+        std::atomic<size_t> NegativeEvictions_{0};
+        std::atomic<size_t> PathEvictions_{0};
+        std::atomic<size_t> Overflows_{0};
     };
 
     [[nodiscard]]
     Y_NO_INLINE
-    TLockGuard<TNaiveSpinLock> TStorage::TImpl::TDentry::LockGuard() {
+    TLockGuard<TAdaptiveLock> TStorage::TImpl::TDentry::LockGuard() {
         return MakeGuard(Lock);
     }
 
@@ -451,22 +761,22 @@ namespace NJK {
         }
         auto g = LockGuard();
         while (State == EState::Uninitialized) {
-            InitCondVar.Wait(Lock);
+            Changed.Wait(Lock);
         }
     }
 
     [[nodiscard]]
     Y_NO_INLINE
-    TStorage::TImpl::TChildNameLockGuard TStorage::TImpl::TDentry::LockChild(const std::string& name) {
+    TStorage::TImpl::TChildNameLockGuard TStorage::TImpl::TDentry::LockChild(std::string_view name) {
         return TChildNameLockGuard(this, name);
     }
 
     Y_NO_INLINE
-    void TStorage::TImpl::TDentry::UnlockChild(const std::string&) {
+    void TStorage::TImpl::TDentry::UnlockChild(std::string_view) {
     }
 
     Y_NO_INLINE
-    std::unique_ptr<TInode> TStorage::TImpl::TDentry::EnsureChild(const std::string& name, const TChildNameLockGuard& g) {
+    std::optional<TInode> TStorage::TImpl::TDentry::EnsureChild(const std::string& name, const TChildNameLockGuard& g) {
         Y_ENSURE(g.Name() == name && g.Dentry() == this);
 
         auto inode = LookupChild(name, g);
@@ -488,11 +798,11 @@ namespace NJK {
             TInodeDataOps ops(Volume);
             ret = ops.EnsureChild(*Inode, name);
         }
-        return std::make_unique<TInode>(std::move(ret));
+        return ret;
     }
 
     Y_NO_INLINE
-    std::unique_ptr<TInode> TStorage::TImpl::TDentry::LookupChild(const std::string& name, const TChildNameLockGuard& g) {
+    std::optional<TInode> TStorage::TImpl::TDentry::LookupChild(const std::string& name, const TChildNameLockGuard& g) {
         Y_ENSURE(g.Name() == name && g.Dentry() == this);
         
         LockDirForRead();
@@ -506,16 +816,26 @@ namespace NJK {
             auto g = LockGuard();
             TInodeDataOps ops(Volume);
             ret = ops.LookupChild(*Inode, name);
-            if (!ret) {
-                return {};
-            }
         }
-        return std::make_unique<TInode>(std::move(*ret));
+        return ret;
     }
 
-    TStorage::TImpl::TChildNameLockGuard::TChildNameLockGuard(TDentry* dentry, std::string name)
+    Y_NO_INLINE
+    std::vector<TInode::TId> TStorage::TImpl::TDentry::EnsureChildren(const std::vector<std::string>& names) {
+        LockDirForWrite();
+        Y_DEFER([this] {
+            UnlockDirForWrite();
+        });
+
+        TODO_BETTER_CONCURRENCY
+        auto g = LockGuard();
+        TInodeDataOps ops(Volume);
+        return ops.EnsureChildren(*Inode, names);
+    }
+
+    TStorage::TImpl::TChildNameLockGuard::TChildNameLockGuard(TDentry* dentry, std::string_view name)
         : Dentry_(dentry)
-        , Name_(std::move(name))
+        , Name_(name)
     {
     }
 
@@ -535,16 +855,201 @@ namespace NJK {
     }
 
     TStorage::TImpl::TDentryWithVolume TStorage::TImpl::ResolvePath(const std::string& path, bool create) {
-        if (path.empty()) {
-            throw std::runtime_error("path is empty");
+        if (!PathCache_) {
+            return ResolvePathUncached(path, create);
+        }
+
+        if (auto node = LookupPathCache(path); node.Dentry) {
+            return node;
+        }
+
+        // Before resolving, so Mount in between makes the result stale
+        const size_t generation = PathGeneration_.load(std::memory_order::acquire);
+        auto node = ResolvePathUncached(path, create);
+        if (node.Dentry) {
+            UpdatePathCache(path, generation, node);
+        }
+        return node;
+    }
+
+    TStorage::TImpl::TDentryWithVolume TStorage::TImpl::LookupPathCache(const std::string& path) {
+        auto entry = PathCache_->Find(std::string_view(path));
+        if (!entry) {
+            return {};
+        }
+
+        TDentryWithVolume node;
+        {
+            auto g = MakeGuard(entry->Lock);
+            if (entry->Generation != PathGeneration_.load(std::memory_order::acquire)) {
+                return {};
+            }
+            node.Volume = entry->Volume;
+            node.Dentry = Wrap(entry->Dentry.Share());
+        }
+        MarkReferenced(*node.Dentry);
+
+        // Same guarantee as StepPath gives
+        {
+            auto g = node.Dentry->LockGuard();
+            Y_VERIFY(node.Dentry->State == TDentry::EState::Exists);
+            ++node.Dentry->PreventRemoval;
+            node.Dentry.PreventRemoval();
+        }
+        return node;
+    }
+
+    void TStorage::TImpl::UpdatePathCache(const std::string& path, size_t generation, const TDentryWithVolume& node) {
+        auto holder = node.Dentry.ShareHolder();
+        if (!holder) {
+            return;
+        }
+
+        auto emplaceResult = PathCache_->emplace_key(std::string_view(path));
+        {
+            auto& entry = emplaceResult.Obj;
+            auto g = MakeGuard(entry->Lock);
+            if (entry->Generation < generation) {
+                entry->Generation = generation;
+                entry->Volume = node.Volume;
+                entry->Dentry = std::move(holder);
+            }
+        }
+        if (emplaceResult.Created) {
+            emplaceResult.Obj = {};
+            OnPathCached(path);
+        }
+    }
+
+    void TStorage::TImpl::OnDentryCreated(TDentryCacheKey key, bool negative) {
+        std::unique_lock g(Eviction_.Lock);
+        auto& queue = negative ? Eviction_.NegativeDentries : Eviction_.Dentries;
+        queue.push_back(std::move(key));
+        EvictDentries(negative);
+    }
+
+    void TStorage::TImpl::OnPathCached(std::string path) {
+        std::unique_lock g(Eviction_.Lock);
+        Eviction_.Paths.push_back(std::move(path));
+        EvictPaths();
+    }
+
+    // Under Eviction_.Lock
+    void TStorage::TImpl::EvictDentries(bool negative) {
+        auto& queue = negative ? Eviction_.NegativeDentries : Eviction_.Dentries;
+        const size_t limit = negative ? DentryCacheSettings_.MaxNegativeDentries : DentryCacheSettings_.MaxDentries;
+        if (!limit || queue.size() <= limit) {
+            return;
+        }
+
+        TODO_PERFORMANCE // flushes under Eviction_.Lock serialize evictions
+        bool becameExisting = false;
+        // Two rounds: the first one may only clear Referenced bits
+        for (size_t scanned = 0, total = 2 * queue.size(); queue.size() > limit && scanned < total; ++scanned) {
+            TDentryCacheKey key = std::move(queue.front());
+            queue.pop_front();
+
+            // Nobody holds it, so nobody can lock it or change it meanwhile.
+            // No I/O here: lookups of the key wait while it's Dead
+            bool exists = false;
+            bool dirty = false;
+            auto canEvict = [&](TDentry& dentry) {
+                if (dentry.Referenced.exchange(false, std::memory_order::relaxed)) {
+                    return false;
+                }
+                if (negative && dentry.State == TDentry::EState::Exists) {
+                    exists = true;
+                    return false;
+                }
+                if (dentry.LocalValue.load(std::memory_order::acquire)) {
+                    dirty = true;
+                    return false;
+                }
+                return true;
+            };
+            bool evicted = DentryCache_.TryEvict(key, canEvict);
+            if (dirty) {
+                dirty = false;
+                // Pinned while flushed, so it's not erased under us
+                bool flushed = false;
+                if (auto dentry = DentryCache_.Find(key)) {
+                    flushed = dentry->TryFlushForEviction();
+                }
+                // Fails again if it was dirtied after the flush
+                if (flushed) {
+                    evicted = DentryCache_.TryEvict(key, canEvict);
+                }
+            }
+
+            if (evicted) {
+                ++(negative ? NegativeEvictions_ : Evictions_);
+            } else if (exists) {
+                // Was created after negative lookup
+                Eviction_.Dentries.push_back(std::move(key));
+                becameExisting = true;
+            } else {
+                queue.push_back(std::move(key));
+            }
+        }
+
+        if (queue.size() > limit) {
+            ++Overflows_;
+        }
+        if (becameExisting) {
+            EvictDentries(false);
+        }
+    }
+
+    // Under Eviction_.Lock
+    void TStorage::TImpl::EvictPaths() {
+        auto& queue = Eviction_.Paths;
+        const size_t limit = DentryCacheSettings_.MaxPaths;
+        if (!limit || queue.size() <= limit) {
+            return;
         }
-        if (path[0] != '/') {
-            throw std::runtime_error("path didn't start from the root");
+
+        // Entries are held only for a moment by lookups, so no second chance
+        for (size_t scanned = 0, total = queue.size(); queue.size() > limit && scanned < total; ++scanned) {
+            std::string path = std::move(queue.front());
+            queue.pop_front();
+            // Entry itself is freed later by TEpoch, release dentry right now
+            const bool evicted = PathCache_->TryEvict(path, [](TPathCacheEntry& entry) {
+                entry.Dentry = {};
+                return true;
+            });
+            if (evicted) {
+                ++PathEvictions_;
+            } else {
+                queue.push_back(std::move(path));
+            }
         }
+    }
 
-        std::string_view dirPath;
-        std::string keyName;
+    TStorage::TDentryCacheStats TStorage::TImpl::GetDentryCacheStats() {
+        TDentryCacheStats stats;
         {
+            std::unique_lock g(Eviction_.Lock);
+            stats.Dentries = Eviction_.Dentries.size();
+            stats.NegativeDentries = Eviction_.NegativeDentries.size();
+            stats.Paths = Eviction_.Paths.size();
+        }
+        stats.Evictions = Evictions_.load();
+        stats.NegativeEvictions = NegativeEvictions_.load();
+        stats.PathEvictions = PathEvictions_.load();
+        stats.Overflows = Overflows_.load();
+        return stats;
+    }
+
+    namespace {
+        // "/a/b//c/" -> {"/a/b//", "c"}
+        std::pair<std::string_view, std::string_view> SplitPath(const std::string& path) {
+            if (path.empty()) {
+                throw std::runtime_error("path is empty");
+            }
+            if (path[0] != '/') {
+                throw std::runtime_error("path didn't start from the root");
+            }
+
             auto b = path.rbegin();
             auto e = path.rend();
             while (b != e && *b == '/') {
@@ -560,9 +1065,15 @@ namespace NJK {
             }
             assert(b != e);
 
-            keyName = {b.base(), keyEnd};
-            dirPath = std::string_view(&*path.begin(), std::distance(path.begin(), b.base()));
+            return {
+                std::string_view(&*path.begin(), std::distance(path.begin(), b.base())),
+                std::string_view(&*b.base(), std::distance(b.base(), keyEnd)),
+            };
         }
+    }
+
+    TStorage::TImpl::TDentryWithVolume TStorage::TImpl::ResolvePathUncached(const std::string& path, bool create) {
+        const auto [dirPath, keyName] = SplitPath(path);
 
         auto dir = ResolveDirs(dirPath, {.Create = create});
         if (!dir.Dentry) {
@@ -571,33 +1082,132 @@ namespace NJK {
         }
 
         if (dir.Dentry->Mounts) {
-            const auto& mounts = *dir.Dentry->Mounts;
-            for (auto it = mounts.rbegin(); it != mounts.rend(); ++it) {
-                const auto mount = TDentryWithVolume::FromMount(*it);
-                auto dentry = StepPath(mount, keyName, {.Create = false});
-                if (dentry) {
-                    return {mount.Volume, std::move(dentry)};
+            return StepMounted(dir, keyName, create);
+        }
+
+        auto dentry = StepPath(dir, keyName, {.Create = create});
+        if (!dentry) {
+            return {};
+        }
+        return {dir.Volume, std::move(dentry)};
+    }
+
+    TStorage::TImpl::TDentryWithVolume TStorage::TImpl::StepMounted(const TDentryWithVolume& dir, std::string_view childName, bool create) {
+        const auto& mounts = *dir.Dentry->Mounts;
+        for (auto it = mounts.rbegin(); it != mounts.rend(); ++it) {
+            const auto mount = TDentryWithVolume::FromMount(*it);
+            auto dentry = StepPath(mount, childName, {.Create = false});
+            if (dentry) {
+                return {mount.Volume, std::move(dentry)};
+            }
+        }
+
+        if (!create) {
+            return {};
+        }
+
+        const auto target = TDentryWithVolume::FromMount(mounts.back());
+        auto dentry = StepPath(target, childName, {.Create = true});
+        if (dentry) {
+            return {target.Volume, std::move(dentry)};
+        }
+
+        return {};
+    }
+
+    std::vector<TStorage::TImpl::TDentryWithVolume> TStorage::TImpl::ResolvePaths(const std::vector<const std::string*>& paths, bool create) {
+        std::vector<TDentryWithVolume> nodes(paths.size());
+
+        struct TKey {
+            std::string_view DirPath;
+            std::string_view Name;
+            size_t Index = 0;
+        };
+
+        // Before resolving, so Mount in between makes the result stale
+        const size_t generation = PathGeneration_.load(std::memory_order::acquire);
+
+        std::vector<TKey> keys;
+        keys.reserve(paths.size());
+        for (size_t i = 0; i < paths.size(); ++i) {
+            if (PathCache_) {
+                nodes[i] = LookupPathCache(*paths[i]);
+                if (nodes[i].Dentry) {
+                    continue;
                 }
             }
+            const auto [dirPath, name] = SplitPath(*paths[i]);
+            keys.push_back({dirPath, name, i});
+        }
 
-            if (!create) {
-                return {};
+        // Stable, so duplicates are resolved in the order they were given
+        std::stable_sort(keys.begin(), keys.end(), [](const TKey& l, const TKey& r) {
+            return l.DirPath < r.DirPath;
+        });
+
+        for (auto groupBegin = keys.begin(); groupBegin != keys.end(); ) {
+            auto groupEnd = std::find_if(groupBegin, keys.end(), [&](const TKey& key) {
+                return key.DirPath != groupBegin->DirPath;
+            });
+            const auto group = std::span(groupBegin, groupEnd);
+            groupBegin = groupEnd;
+
+            auto dir = ResolveDirs(group.front().DirPath, {.Create = create});
+            if (!dir.Dentry) {
+                Y_ENSURE(!create);
+                continue;
             }
 
-            const auto target = TDentryWithVolume::FromMount(dir.Dentry->Mounts->back());
-            auto dentry = StepPath(target, keyName, {.Create = true});
-            if (dentry) {
-                return {target.Volume, std::move(dentry)};
+            if (dir.Dentry->Mounts) {
+                for (const auto& key : group) {
+                    nodes[key.Index] = StepMounted(dir, key.Name, create);
+                }
+                continue;
             }
 
-            return {};
+            // Children that are not known to exist yet are added in one
+            // directory rewrite instead of one per key
+            std::vector<std::optional<TInode::TId>> childIds(group.size());
+            if (create) {
+                std::vector<std::string> names;
+                std::vector<size_t> positions;
+                for (size_t j = 0; j < group.size(); ++j) {
+                    const TDentryCacheKeyView cacheKey{dir, group[j].Name};
+                    if (auto cached = DentryCache_.Find(cacheKey)) {
+                        auto g = cached->LockGuard();
+                        if (cached->State == TDentry::EState::Exists) {
+                            continue;
+                        }
+                    }
+                    names.emplace_back(group[j].Name);
+                    positions.push_back(j);
+                }
+
+                if (!names.empty()) {
+                    auto ids = dir.Dentry->EnsureChildren(names);
+                    for (size_t k = 0; k < ids.size(); ++k) {
+                        childIds[positions[k]] = ids[k];
+                    }
+                }
+            }
+
+            for (size_t j = 0; j < group.size(); ++j) {
+                auto dentry = StepPath(dir, group[j].Name, {.Create = create, .ChildInodeId = childIds[j]});
+                if (dentry) {
+                    nodes[group[j].Index] = {dir.Volume, std::move(dentry)};
+                }
+            }
         }
 
-        auto dentry = StepPath(dir, keyName, {.Create = create});
-        if (!dentry) {
-            return {};
+        if (PathCache_) {
+            for (const auto& key : keys) {
+                if (nodes[key.Index].Dentry) {
+                    UpdatePathCache(*paths[key.Index], generation, nodes[key.Index]);
+                }
+            }
         }
-        return {dir.Volume, std::move(dentry)};
+
+        return nodes;
     }
 
     //void TStorage::TImpl::EnsureInodeData(TDentryWithVolume node) {
@@ -644,8 +1254,8 @@ namespace NJK {
 
     */
 
-    TStorage::TImpl::TDentryWithGuards TStorage::TImpl::StepPath(const TDentryWithVolume& parentExt, const std::string& childName, const TResolveParams& params) {
-        using TInodePtr = std::unique_ptr<TInode>;
+    TStorage::TImpl::TDentryWithGuards TStorage::TImpl::StepPath(const TDentryWithVolume& parentExt, std::string_view childName, const TResolveParams& params) {
+        using TInodePtr = std::optional<TInode>;
 
         auto* volume = parentExt.Volume;
         auto& parent = parentExt.Dentry;
@@ -653,7 +1263,8 @@ namespace NJK {
         // 1. parent ++ref_count to prevent cache removal (inside hashmap impl)
         // 2. parent can be in NotExists state, so lock this 
 
-        const TDentryCacheKey childCacheKey{{volume, parent->Inode->Id}, childName};
+        // Name is copied only if dentry is not cached yet
+        const TDentryCacheKeyView childCacheKey{{volume, parent->Inode->Id}, childName};
         auto emplaceResult = DentryCache_.emplace_key(childCacheKey);
         auto child = Wrap(std::move(emplaceResult.Obj));
 
@@ -661,24 +1272,27 @@ namespace NJK {
             auto childGuard = parent->LockChild(childName);
             {
                 Y_DEFER([&](){
-                    child->InitCondVar.NotifyAll();
+                    child->Changed.NotifyAll();
                 });
 
+                std::string name(childName);
                 TInodePtr childInode;
-                if (params.Create) {
-                    childInode = parent->EnsureChild(childName, childGuard);
+                if (params.ChildInodeId) {
+                    childInode = volume->ReadInode(*params.ChildInodeId);
+                } else if (params.Create) {
+                    childInode = parent->EnsureChild(name, childGuard);
                 } else {
-                    childInode = parent->LookupChild(childName, childGuard);
+                    childInode = parent->LookupChild(name, childGuard);
                 }
 
                 if (!childInode) {
                     {
                         auto g = child->LockGuard();
                         child->State = TDentry::EState::NotExists;
-                        child->InParentName = std::move(childName);
                         child->Volume = volume;
                     }
                     child->Initialized.store(1);
+                    OnDentryCreated(TDentryCacheKey(childCacheKey), true);
                     return {};
                 }
 
@@ -686,16 +1300,17 @@ namespace NJK {
                     auto g = child->LockGuard();
                     child->Inode = std::move(childInode);
                     child->State = TDentry::EState::Exists;
-                    child->InParentName = std::move(childName);
                     child->Volume = volume;
                     ++child->PreventRemoval;
                     child.PreventRemoval();
                 }
                 child->Initialized.store(1);
             }
+            OnDentryCreated(TDentryCacheKey(childCacheKey), false);
             return child;
         } else {
             child->WaitInitialized(); // TODO Don't take lock twice
+            MarkReferenced(*child);
 
             auto childGuard = parent->LockChild(childName);
 
@@ -711,7 +1326,7 @@ namespace NJK {
                     }
 
                     while (child->CreateLocked) {
-                        child->CreateCondVar.Wait(child->Lock);
+                        child->Changed.Wait(child->Lock);
                     }
                     if (child->State == TDentry::EState::NotExists) {
                         child->CreateLocked = true;
@@ -720,7 +1335,9 @@ namespace NJK {
                 }
             }
 
-            TInodePtr childInode = parent->EnsureChild(childName, childGuard);
+            TInodePtr childInode = params.ChildInodeId
+                ? volume->ReadInode(*params.ChildInodeId)
+                : parent->EnsureChild(std::string(childName), childGuard);
             {
                 auto g = child->LockGuard();
                 child->Inode = std::move(childInode);
@@ -729,7 +1346,7 @@ namespace NJK {
                 child.PreventRemoval();
                 child->CreateLocked = false;
             }
-            child->CreateCondVar.NotifyAll(); // FIXME
+            child->Changed.NotifyAll(); // FIXME
 
             return child;
         }
@@ -760,7 +1377,7 @@ namespace NJK {
             }
             Y_ENSURE(start != end);
 
-            const std::string childName(start, end); // FIXME string_view
+            const std::string_view childName(&*start, std::distance(start, end));
             cur.Dentry = StepPath(cur, childName, params);
             if (!cur.Dentry) {
                 return {};
@@ -813,13 +1430,8 @@ namespace NJK {
         {
             auto g = dentry.LockGuard();
             if (dentry.State == TDentry::EState::Uninitialized) {
-                std::stringstream s;
-                s << (void*)srcVolume << srcVolume->GetFsDir() << '@' << srcDir;
-                dentry.InParentName = s.str();
                 dentry.Volume = srcVolume;
-                // TODO Better
-                dentry.Inode.reset(new TInode());
-                *dentry.Inode = std::move(srcInode);
+                dentry.Inode = std::move(srcInode);
                 dentry.State = TDentry::EState::Exists;
             }
         }
@@ -829,6 +1441,10 @@ namespace NJK {
     }
 
     void TStorage::TImpl::Mount(const std::string& mountPointPath, TVolume* srcVolume, const std::string& srcDir) {
+        Y_DEFER([this] {
+            PathGeneration_.fetch_add(1, std::memory_order::release);
+        });
+
         auto mountPoint = ResolveDirs(mountPointPath, {.Create = true});
         if (!mountPoint.Dentry->Mounts) {
             mountPoint.Dentry->Mounts.reset(new std::vector<TMount>());
@@ -836,6 +1452,9 @@ namespace NJK {
         auto& mount = mountPoint.Dentry->Mounts->emplace_back();
         mount.Volume = srcVolume;
         mount.Dentry = EnsureMountedInode(srcVolume, srcDir);
+
+        // Mounts live in dentry, so it must never be evicted
+        MountPoints_.push_back(mountPoint.Dentry.ShareHolder());
     }
 
     TStorage::TImpl::~TImpl() {
@@ -860,10 +1479,42 @@ namespace NJK {
         Impl_->Set(path, value, deadline);
     }
 
+    void TStorage::MultiSet(std::span<const std::pair<std::string, TValue>> items, ui32 deadline) {
+        Impl_->MultiSet(items, deadline);
+    }
+
+    std::vector<TStorage::TValue> TStorage::MultiGet(std::span<const std::string> paths) {
+        return Impl_->MultiGet(paths);
+    }
+
+    TStorage::TValue TStorage::Update(const std::string& path, const TUpdateFunc& fn, ui32 deadline) {
+        return Impl_->Update(path, fn, deadline);
+    }
+
+    ui32 TStorage::Increment(const std::string& path, ui32 delta) {
+        return Impl_->Increment(path, delta);
+    }
+
+    bool TStorage::CompareAndSet(const std::string& path, const TValue& expected, const TValue& desired, ui32 deadline) {
+        return Impl_->CompareAndSet(path, expected, desired, deadline);
+    }
+
     void TStorage::Mount(const std::string& mountPoint, TVolume* src, const std::string& srcDir) {
         Impl_->Mount(mountPoint, src, srcDir);
     }
 
+    void TStorage::EnablePathCache() {
+        Impl_->EnablePathCache();
+    }
+
+    TStorage::TDentryCacheStats TStorage::GetDentryCacheStats() const {
+        return Impl_->GetDentryCacheStats();
+    }
+
+    void TStorage::SetDentryCacheSettings(const TDentryCacheSettings& settings) {
+        Impl_->SetDentryCacheSettings(settings);
+    }
+
     TStorage::TValue TStorage::Get(const std::string& path) {
         return Impl_->Get(path);
     }
@@ -2,15 +2,38 @@
 
 #include "volume.h"
 #include "volume/value.h"
+#include <functional>
 #include <memory>
+#include <optional>
+#include <span>
+#include <utility>
 #include <variant>
+#include <vector>
 
 namespace NJK {
 
+    // Limits on cached dentries, 0 means unbounded. Referenced dentries are
+    // never evicted, so the limits are soft.
+    struct TDentryCacheSettings {
+        size_t MaxDentries = 1 << 20; // existing ones, evicted after flushing value
+        size_t MaxNegativeDentries = 1 << 16; // results of lookups of missing names
+        size_t MaxPaths = 1 << 19; // path cache entries, each one pins its dentry
+    };
+
     class TStorage {
     public:
         using TValue = NVolume::TInodeValue; // TODO Copy + static_assert?
 
+        struct TDentryCacheStats {
+            size_t Dentries = 0;
+            size_t NegativeDentries = 0;
+            size_t Paths = 0;
+            size_t Evictions = 0;
+            size_t NegativeEvictions = 0;
+            size_t PathEvictions = 0;
+            size_t Overflows = 0; // nothing to evict (all referenced), limit exceeded
+        };
+
         friend class TStorageBuilder;
         ~TStorage();
 
@@ -23,9 +46,29 @@ namespace NJK {
         TValue Get(const std::string& path);
         void Erase(const std::string& path);
 
+        // Atomic read-modify-write. Returns new value or std::nullopt to keep
+        // current one, may be called several times, so no side effects
+        using TUpdateFunc = std::function<std::optional<TValue>(const TValue&)>;
+
+        // Returns value fn was applied to
+        TValue Update(const std::string& path, const TUpdateFunc& fn, ui32 deadline = 0);
+        // Missing value counts as zero, returns new value. Only ui32 is supported
+        ui32 Increment(const std::string& path, ui32 delta = 1);
+        // Missing value is std::monostate
+        bool CompareAndSet(const std::string& path, const TValue& expected, const TValue& desired, ui32 deadline = 0);
+
+        // Same as Set/Get for each key, but keys of one directory share path
+        // resolution and new ones are added to directory at once
+        void MultiSet(std::span<const std::pair<std::string, TValue>> items, ui32 deadline = 0);
+        std::vector<TValue> MultiGet(std::span<const std::string> paths);
+
+        TDentryCacheStats GetDentryCacheStats() const;
+
     private:
         explicit TStorage(TVolume* root, const std::string& dir = "/");
         void Mount(const std::string& mountPoint, TVolume* src, const std::string& srcDir = "/");
+        void EnablePathCache();
+        void SetDentryCacheSettings(const TDentryCacheSettings& settings);
 
     private:
         class TImpl;
@@ -44,6 +87,17 @@ namespace NJK {
             return *this;
         }
 
+        // Whole path -> dentry cache, one lookup per hot path instead of one per level
+        TStorageBuilder& PathCache() {
+            Storage_.EnablePathCache();
+            return *this;
+        }
+
+        TStorageBuilder& DentryCache(const TDentryCacheSettings& settings) {
+            Storage_.SetDentryCacheSettings(settings);
+            return *this;
+        }
+
         TStorage Build() {
             return std::move(Storage_);
         }
@@ -1,5 +1,6 @@
 #include "block_group.h"
 
+#include "../atomic.h"
 #include "../saveload.h"
 #include "../block_file.h"
 
@@ -32,8 +33,10 @@ namespace NJK::NVolume {
     {
         Y_ENSURE(SuperBlock->BlockGroupInodeCount == SuperBlock->BlockGroupDataBlockCount);
 
-        Inodes.CopyFrom(File_.GetBlock(InodesBitmapBlockIndex).Buf());
-        DataBlocks.CopyFrom(File_.GetBlock(DataBlocksBitmapBlockIndex).Buf());
+        // Adjacent, so one read on miss
+        auto bitmaps = File_.GetBlocks({InodesBitmapBlockIndex, DataBlocksBitmapBlockIndex});
+        Inodes.CopyFrom(bitmaps[0].Buf());
+        DataBlocks.CopyFrom(bitmaps[1].Buf());
     }
 
     TBlockGroup::~TBlockGroup() {
@@ -44,36 +47,44 @@ namespace NJK::NVolume {
         Inode management
     */
     ui32 TBlockGroup::TAllocatableItems::GetFreeCount() {
-        std::unique_lock g(Lock_);
-        return FreeCount;
+        return FreeCount.load(std::memory_order::relaxed);
     }
 
     i32 TBlockGroup::TAllocatableItems::TryAllocate() {
-        std::unique_lock g(Lock_);
-
-        if (!FreeCount) {
+        if (!TrySub(FreeCount)) {
             return -1;
         }
-        --FreeCount;
 
-        const i32 idx = Bitmap.FindUnset();
-        Y_VERIFY(idx != -1); // For now (we use mutual exclusion) this is impossible
-        if (idx == -1) {
+        // Some bit is unset for us, but concurrent allocations and
+        // deallocations may move it behind the scan, so rescan once
+        for (bool useHint : {true, false}) {
+            const i32 idx = Bitmap.TrySetBit(useHint);
+            if (idx != -1) {
+                return idx;
+            }
+        }
+
+        // FreeCount doesn't match bitmap (or rare race), let caller try others
+        ++FreeCount;
+        return -1;
+    }
+
+    i32 TBlockGroup::TAllocatableItems::TryAllocateRange(ui32 count) {
+        if (!TrySub(FreeCount, count)) {
             return -1;
         }
-        Y_ASSERT(!Bitmap.Test(idx));
-        Bitmap.Set(idx);
-        Y_ASSERT(Bitmap.Test(idx));
 
+        const i32 idx = Bitmap.TrySetRange(count);
+        if (idx == -1) {
+            FreeCount += count;
+        }
         return idx;
     }
 
     void TBlockGroup::TAllocatableItems::Deallocate(ui32 idx) {
-        std::unique_lock g(Lock_);
-        ++FreeCount;
         Y_ASSERT(Bitmap.Test(idx));
         Bitmap.Unset(idx);
-        Y_ASSERT(!Bitmap.Test(idx));
+        ++FreeCount;
     }
 
     std::optional<TInode> TBlockGroup::TryAllocateInode() {
@@ -133,13 +144,21 @@ namespace NJK::NVolume {
 
         i32 idx = DataBlocks.TryAllocate();
         if (idx == -1) {
-            return {};
+            return -1;
         }
 
         const ui32 id = idx + DataBlockIndexOffset;
         return id;
     }
 
+    i32 TBlockGroup::TryAllocateDataBlocks(ui32 count) {
+        const i32 idx = DataBlocks.TryAllocateRange(count);
+        if (idx == -1) {
+            return -1;
+        }
+        return idx + DataBlockIndexOffset;
+    }
+
     void TBlockGroup::DeallocateDataBlock(ui32 id) {
         auto idx = id - DataBlockIndexOffset;
         DataBlocks.Deallocate(idx);
@@ -152,6 +171,16 @@ namespace NJK::NVolume {
     TCachedBlockFile::TPage<true> TBlockGroup::GetMutableDataBlock(ui32 id) {
         return File_.GetMutableBlock(CalcDataBlockIndex(id));
     }
+    TCachedBlockFile::TPage<true> TBlockGroup::GetDataBlockForOverwrite(ui32 id) {
+        return File_.GetBlockForOverwrite(CalcDataBlockIndex(id));
+    }
+    std::vector<TCachedBlockFile::TPage<false>> TBlockGroup::GetDataBlocks(ui32 firstId, ui32 count) {
+        std::vector<size_t> idxs(count);
+        for (ui32 i = 0; i < count; ++i) {
+            idxs[i] = CalcDataBlockIndex(firstId + i);
+        }
+        return File_.GetBlocks(std::move(idxs));
+    }
 
     //void TBlockGroup::WriteDataBlock(const TDataBlock& block) {
     //    Y_FAIL("");
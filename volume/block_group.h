@@ -33,6 +33,10 @@ namespace NJK::NVolume {
         TBlockGroup(size_t inFileOffset, ui32 inodeOffset, TCachedBlockFile& file, const TSuperBlock& sb, const TBlockGroupDescr& start);
         ~TBlockGroup();
 
+        // Relative to group start
+        static constexpr size_t InodesBitmapBlockIndex = 0;
+        static constexpr size_t DataBlocksBitmapBlockIndex = 1;
+
         ui32 GetFreeInodeCount() {
             return Inodes.GetFreeCount();
         }
@@ -48,10 +52,28 @@ namespace NJK::NVolume {
         }
 
         i32 TryAllocateDataBlock();
+        // Contiguous, returns first id
+        i32 TryAllocateDataBlocks(ui32 count);
         void DeallocateDataBlock(ui32);
 
         TCachedBlockFile::TPage<false> GetDataBlock(ui32 id);
         TCachedBlockFile::TPage<true> GetMutableDataBlock(ui32 id);
+        TCachedBlockFile::TPage<true> GetDataBlockForOverwrite(ui32 id);
+        std::vector<TCachedBlockFile::TPage<false>> GetDataBlocks(ui32 firstId, ui32 count);
+
+        // Block indexes in meta group file, for batched and prefetched reads
+        size_t GetInodeFileBlockIndex(ui32 inodeId) const {
+            return File_.GetOffset() + CalcInodeBlockIndex(inodeId);
+        }
+        size_t GetDataFileBlockIndex(ui32 blockId) const {
+            return File_.GetOffset() + CalcDataBlockIndex(blockId);
+        }
+
+        // Copy allocation bitmaps into cached blocks
+        void Flush() {
+            Inodes.CopyTo(File_.GetMutableBlock(InodesBitmapBlockIndex).Buf());
+            DataBlocks.CopyTo(File_.GetMutableBlock(DataBlocksBitmapBlockIndex).Buf());
+        }
 
     private:
         TFixedBuffer NewBuffer() {
@@ -73,14 +95,6 @@ namespace NJK::NVolume {
             return ret;
         }
 
-        void Flush() {
-            Inodes.Bitmap.Buf().CopyTo(File_.GetMutableBlock(InodesBitmapBlockIndex).Buf());
-            DataBlocks.Bitmap.Buf().CopyTo(File_.GetMutableBlock(DataBlocksBitmapBlockIndex).Buf());
-        }
-
-        static constexpr size_t InodesBitmapBlockIndex = 0;
-        static constexpr size_t DataBlocksBitmapBlockIndex = 1;
-
         const TSuperBlock* SuperBlock{};
         TCachedBlockFileRegion File_;
 
@@ -89,27 +103,32 @@ namespace NJK::NVolume {
         const ui32 InodeIndexOffset = 0;
         const ui32 DataBlockIndexOffset = 0;
 
+        // Lock-free: FreeCount reserves items before their bits are set
+        // and is returned after bits are unset, so a reserved item exists
         struct TAllocatableItems {
-            TODO_BETTER_CONCURRENCY
-
-            std::mutex Lock_;
-            size_t FreeCount = 0;
+            std::atomic<size_t> FreeCount = 0;
             TBlockBitSet Bitmap; // 4096 bytes
 
             ui32 GetFreeCount();
             i32 TryAllocate();
+            // First of count free items in a row
+            i32 TryAllocateRange(ui32 count);
             void Deallocate(ui32);
 
+            // Not concurrent with allocations
             void Clear() {
-                std::unique_lock g(Lock_);
                 Bitmap.Buf().FillZeroes();
             }
 
+            // Not concurrent with allocations
             void CopyFrom(const TFixedBuffer& src) {
-                std::unique_lock g(Lock_);
                 src.CopyTo(Bitmap.Buf());
             }
 
+            void CopyTo(TFixedBuffer& dst) {
+                Bitmap.CopyTo(dst);
+            }
+
             //std::vector<bool> Debug;
         };
         
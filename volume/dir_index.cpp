@@ -0,0 +1,79 @@
+#include "dir_index.h"
+
+#include <cstring>
+
+namespace NJK::NVolume {
+
+    ui16 TDirIndexBlock::GetCount(const TFixedBuffer& buf) {
+        ui16 count = 0;
+        std::memcpy(&count, buf.Data(), sizeof(count));
+        return count;
+    }
+
+    void TDirIndexBlock::SetCount(TFixedBuffer& buf, ui16 count) {
+        std::memcpy(buf.MutableData(), &count, sizeof(count));
+    }
+
+    TDirIndexBlock::TEntry TDirIndexBlock::GetEntry(const TFixedBuffer& buf, size_t index) {
+        TEntry entry;
+        std::memcpy(&entry, buf.Data() + HeaderSize + index * sizeof(TEntry), sizeof(TEntry));
+        return entry;
+    }
+
+    void TDirIndexBlock::SetEntry(TFixedBuffer& buf, size_t index, const TEntry& entry) {
+        std::memcpy(buf.MutableData() + HeaderSize + index * sizeof(TEntry), &entry, sizeof(TEntry));
+    }
+
+    size_t TDirIndexBlock::Find(const TFixedBuffer& buf, ui32 hash) {
+        const size_t count = GetCount(buf);
+        Y_VERIFY(count > 0);
+
+        // First entry with greater hash, skipping the lower bound one
+        size_t left = 1;
+        size_t right = count;
+        while (left < right) {
+            const size_t mid = (left + right) / 2;
+            if (GetEntry(buf, mid).Hash <= hash) {
+                left = mid + 1;
+            } else {
+                right = mid;
+            }
+        }
+        return left - 1;
+    }
+
+    void TDirIndexBlock::Init(TFixedBuffer& buf) {
+        std::memset(buf.MutableData(), 0, HeaderSize);
+    }
+
+    void TDirIndexBlock::Insert(TFixedBuffer& buf, size_t index, const TEntry& entry) {
+        const size_t count = GetCount(buf);
+        Y_VERIFY(count < GetCapacity(buf.Size()));
+        Y_VERIFY(index <= count);
+
+        char* pos = buf.MutableData() + HeaderSize + index * sizeof(TEntry);
+        std::memmove(pos + sizeof(TEntry), pos, (count - index) * sizeof(TEntry));
+        SetEntry(buf, index, entry);
+        SetCount(buf, count + 1);
+    }
+
+    void TDirIndexBlock::Erase(TFixedBuffer& buf, size_t index) {
+        const size_t count = GetCount(buf);
+        Y_VERIFY(index < count);
+
+        char* pos = buf.MutableData() + HeaderSize + index * sizeof(TEntry);
+        std::memmove(pos, pos + sizeof(TEntry), (count - index - 1) * sizeof(TEntry));
+        SetCount(buf, count - 1);
+    }
+
+    void TDirIndexBlock::MoveTail(TFixedBuffer& src, size_t index, TFixedBuffer& dst) {
+        const size_t count = GetCount(src);
+        Y_VERIFY(index <= count);
+
+        Init(dst);
+        std::memcpy(dst.MutableData() + HeaderSize, src.Data() + HeaderSize + index * sizeof(TEntry), (count - index) * sizeof(TEntry));
+        SetCount(dst, count - index);
+        SetCount(src, index);
+    }
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "../common.h"
+#include "../fixed_buffer.h"
+
+#include <string_view>
+
+namespace NJK::NVolume {
+
+    // Index block of hashed directory (htree):
+    //   ui16 Count, ui16 Reserved, Count entries sorted by hash
+    // Entry i covers name hashes [Hash(i), Hash(i + 1)) and points to leaf
+    // or to index block of the next level. Hash of first entry is lower
+    // bound of the whole block, it's not compared on lookup.
+    class TDirIndexBlock {
+    public:
+        struct TEntry {
+            ui32 Hash = 0;
+            ui32 BlockId = 0;
+        };
+
+        static constexpr size_t HeaderSize = 4;
+
+        // Stable between runs, it's stored on disk
+        static ui32 HashName(std::string_view name) {
+            ui32 hash = 2166136261u; // FNV-1a
+            for (const char c : name) {
+                hash ^= static_cast<ui8>(c);
+                hash *= 16777619u;
+            }
+            return hash;
+        }
+
+        static size_t GetCapacity(size_t blockSize) {
+            return (blockSize - HeaderSize) / sizeof(TEntry);
+        }
+
+        static ui16 GetCount(const TFixedBuffer& buf);
+        static TEntry GetEntry(const TFixedBuffer& buf, size_t index);
+        static void SetEntry(TFixedBuffer& buf, size_t index, const TEntry& entry);
+
+        // Index of entry covering hash
+        static size_t Find(const TFixedBuffer& buf, ui32 hash);
+
+        static void Init(TFixedBuffer& buf);
+        static void Insert(TFixedBuffer& buf, size_t index, const TEntry& entry);
+        static void Erase(TFixedBuffer& buf, size_t index);
+        // Moves entries from index to the end into empty block dst
+        static void MoveTail(TFixedBuffer& src, size_t index, TFixedBuffer& dst);
+
+    private:
+        static void SetCount(TFixedBuffer& buf, ui16 count);
+    };
+
+}
@@ -0,0 +1,175 @@
+#include "dir_leaf.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <limits>
+
+namespace NJK::NVolume {
+
+    TDirLeafBlock::THeader TDirLeafBlock::GetHeader(const TFixedBuffer& buf) {
+        THeader header;
+        std::memcpy(&header.Count, buf.Data(), sizeof(ui16));
+        std::memcpy(&header.HeapStart, buf.Data() + sizeof(ui16), sizeof(ui16));
+        std::memcpy(&header.Garbage, buf.Data() + 2 * sizeof(ui16), sizeof(ui16));
+        Y_VERIFY(HeaderSize + header.Count * sizeof(ui16) <= header.HeapStart && header.HeapStart <= buf.Size());
+        return header;
+    }
+
+    void TDirLeafBlock::SetHeader(TFixedBuffer& buf, const THeader& header) {
+        std::memcpy(buf.MutableData(), &header.Count, sizeof(ui16));
+        std::memcpy(buf.MutableData() + sizeof(ui16), &header.HeapStart, sizeof(ui16));
+        std::memcpy(buf.MutableData() + 2 * sizeof(ui16), &header.Garbage, sizeof(ui16));
+    }
+
+    ui16 TDirLeafBlock::GetSlot(const TFixedBuffer& buf, size_t index) {
+        ui16 offset = 0;
+        std::memcpy(&offset, buf.Data() + HeaderSize + index * sizeof(ui16), sizeof(ui16));
+        return offset;
+    }
+
+    void TDirLeafBlock::SetSlot(TFixedBuffer& buf, size_t index, ui16 offset) {
+        std::memcpy(buf.MutableData() + HeaderSize + index * sizeof(ui16), &offset, sizeof(ui16));
+    }
+
+    TDirLeafBlock::TEntry TDirLeafBlock::GetEntryAt(const TFixedBuffer& buf, size_t offset) {
+        const char* pos = buf.Data() + offset;
+        TEntry entry;
+        std::memcpy(&entry.Id, pos, sizeof(ui32));
+        entry.Name = {pos + EntryHeaderSize, static_cast<ui8>(pos[sizeof(ui32)])};
+        return entry;
+    }
+
+    ui16 TDirLeafBlock::GetCount(const TFixedBuffer& buf) {
+        ui16 count = 0;
+        std::memcpy(&count, buf.Data(), sizeof(count));
+        return count;
+    }
+
+    TDirLeafBlock::TEntry TDirLeafBlock::GetEntry(const TFixedBuffer& buf, size_t index) {
+        return GetEntryAt(buf, GetSlot(buf, index));
+    }
+
+    size_t TDirLeafBlock::LowerBound(const TFixedBuffer& buf, std::string_view name) {
+        // Branchless: range halves on each step whatever the comparison is
+        size_t first = 0;
+        size_t count = GetCount(buf);
+        while (count > 1) {
+            const size_t half = count / 2;
+            first += GetEntry(buf, first + half - 1).Name < name ? half : 0;
+            count -= half;
+        }
+        if (count == 1 && GetEntry(buf, first).Name < name) {
+            ++first;
+        }
+        return first;
+    }
+
+    void TDirLeafBlock::Init(TFixedBuffer& buf) {
+        Y_VERIFY(buf.Size() <= std::numeric_limits<ui16>::max());
+        SetHeader(buf, {0, static_cast<ui16>(buf.Size()), 0});
+    }
+
+    std::optional<ui32> TDirLeafBlock::Find(const TFixedBuffer& buf, std::string_view name) {
+        const size_t index = LowerBound(buf, name);
+        if (index == GetCount(buf)) {
+            return {};
+        }
+        const auto entry = GetEntry(buf, index);
+        if (entry.Name != name) {
+            return {};
+        }
+        return entry.Id;
+    }
+
+    bool TDirLeafBlock::Insert(TFixedBuffer& buf, ui32 id, std::string_view name) {
+        Y_ENSURE(name.size() <= std::numeric_limits<ui8>::max());
+
+        const size_t size = EntryHeaderSize + name.size();
+        THeader header = GetHeader(buf);
+        const size_t free = header.HeapStart - HeaderSize - header.Count * sizeof(ui16);
+        if (free < size + sizeof(ui16)) {
+            if (free + header.Garbage < size + sizeof(ui16)) {
+                return false;
+            }
+            Compact(buf);
+            header = GetHeader(buf);
+        }
+
+        const size_t index = LowerBound(buf, name);
+        Y_VERIFY(index == header.Count || GetEntry(buf, index).Name != name);
+
+        header.HeapStart -= size;
+        char* pos = buf.MutableData() + header.HeapStart;
+        std::memcpy(pos, &id, sizeof(id));
+        pos[sizeof(ui32)] = static_cast<char>(name.size());
+        std::memcpy(pos + EntryHeaderSize, name.data(), name.size());
+
+        char* slots = buf.MutableData() + HeaderSize;
+        std::memmove(slots + (index + 1) * sizeof(ui16), slots + index * sizeof(ui16), (header.Count - index) * sizeof(ui16));
+        SetSlot(buf, index, header.HeapStart);
+
+        ++header.Count;
+        SetHeader(buf, header);
+        return true;
+    }
+
+    std::optional<ui32> TDirLeafBlock::Remove(TFixedBuffer& buf, std::string_view name) {
+        const size_t index = LowerBound(buf, name);
+        THeader header = GetHeader(buf);
+        if (index == header.Count) {
+            return {};
+        }
+        const ui16 offset = GetSlot(buf, index);
+        const auto entry = GetEntryAt(buf, offset);
+        if (entry.Name != name) {
+            return {};
+        }
+
+        char* slots = buf.MutableData() + HeaderSize;
+        std::memmove(slots + index * sizeof(ui16), slots + (index + 1) * sizeof(ui16), (header.Count - index - 1) * sizeof(ui16));
+
+        const size_t size = EntryHeaderSize + entry.Name.size();
+        --header.Count;
+        if (!header.Count) {
+            header = {0, static_cast<ui16>(buf.Size()), 0};
+        } else if (offset == header.HeapStart) {
+            header.HeapStart += size;
+        } else {
+            header.Garbage += size;
+        }
+        SetHeader(buf, header);
+        return entry.Id;
+    }
+
+    bool TDirLeafBlock::NeedsCompaction(const TFixedBuffer& buf) {
+        return GetHeader(buf).Garbage > (buf.Size() - HeaderSize) / 2;
+    }
+
+    void TDirLeafBlock::Compact(TFixedBuffer& buf) {
+        THeader header = GetHeader(buf);
+        // Aligned buffer and even HeaderSize, so slots are aligned too
+        ui16* slots = reinterpret_cast<ui16*>(buf.MutableData() + HeaderSize);
+        ui16* slotsEnd = slots + header.Count;
+
+        // Highest entries first, so each one moves up over garbage only
+        std::sort(slots, slotsEnd, std::greater<ui16>());
+        size_t heapStart = buf.Size();
+        for (ui16* slot = slots; slot != slotsEnd; ++slot) {
+            char* entry = buf.MutableData() + *slot;
+            const size_t size = EntryHeaderSize + static_cast<ui8>(entry[sizeof(ui32)]);
+            heapStart -= size;
+            std::memmove(buf.MutableData() + heapStart, entry, size);
+            *slot = heapStart;
+        }
+
+        std::sort(slots, slotsEnd, [&buf](ui16 lhs, ui16 rhs) {
+            return GetEntryAt(buf, lhs).Name < GetEntryAt(buf, rhs).Name;
+        });
+
+        header.HeapStart = heapStart;
+        header.Garbage = 0;
+        SetHeader(buf, header);
+    }
+
+}
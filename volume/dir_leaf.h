@@ -0,0 +1,81 @@
+#pragma once
+
+#include "../common.h"
+#include "../fixed_buffer.h"
+
+#include <optional>
+#include <string_view>
+
+namespace NJK::NVolume {
+
+    // Leaf block of directory (the only one for small directories):
+    //   ui16 Count, ui16 HeapStart, ui16 Garbage,
+    //   ui16 slots[Count] -- entry offsets sorted by entry name,
+    //   free space,
+    //   entries from HeapStart to the block end of
+    //     ui32 Id, ui8 NameLen, Name
+    //
+    // Entries are added below HeapStart, so insert writes the entry and
+    // shifts only the slots. Bytes of removed entries are counted in Garbage
+    // until compaction moves live ones together.
+    class TDirLeafBlock {
+    public:
+        struct TEntry {
+            ui32 Id = 0;
+            std::string_view Name;
+        };
+
+        static constexpr size_t HeaderSize = 3 * sizeof(ui16);
+        static constexpr size_t EntryHeaderSize = sizeof(ui32) + sizeof(ui8);
+
+        // With its slot
+        static size_t GetEntrySize(size_t nameLen) {
+            return sizeof(ui16) + EntryHeaderSize + nameLen;
+        }
+
+        static ui16 GetCount(const TFixedBuffer& buf);
+        // In name order, index < GetCount()
+        static TEntry GetEntry(const TFixedBuffer& buf, size_t index);
+        // Index of the first entry with name not less than name
+        static size_t LowerBound(const TFixedBuffer& buf, std::string_view name);
+
+        static void Init(TFixedBuffer& buf);
+
+        // In place, without allocations
+        static std::optional<ui32> Find(const TFixedBuffer& buf, std::string_view name);
+
+        // Name must be absent. Compacts if only garbage prevents insertion,
+        // returns false if entry doesn't fit anyway.
+        static bool Insert(TFixedBuffer& buf, ui32 id, std::string_view name);
+
+        // Returns id of removed entry
+        static std::optional<ui32> Remove(TFixedBuffer& buf, std::string_view name);
+
+        static bool NeedsCompaction(const TFixedBuffer& buf);
+        static void Compact(TFixedBuffer& buf);
+
+        // f(ui32 id, std::string_view name) in name order
+        template <typename F>
+        static void ForEach(const TFixedBuffer& buf, F&& f) {
+            const size_t count = GetCount(buf);
+            for (size_t i = 0; i < count; ++i) {
+                const auto entry = GetEntry(buf, i);
+                f(entry.Id, entry.Name);
+            }
+        }
+
+    private:
+        struct THeader {
+            ui16 Count = 0;
+            ui16 HeapStart = 0;
+            ui16 Garbage = 0;
+        };
+
+        static THeader GetHeader(const TFixedBuffer& buf);
+        static void SetHeader(TFixedBuffer& buf, const THeader& header);
+        static ui16 GetSlot(const TFixedBuffer& buf, size_t index);
+        static void SetSlot(TFixedBuffer& buf, size_t index, ui16 offset);
+        static TEntry GetEntryAt(const TFixedBuffer& buf, size_t offset);
+    };
+
+}
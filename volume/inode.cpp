@@ -5,8 +5,8 @@ namespace NJK::NVolume {
 
     Y_DEFINE_SERIALIZATION(TInode,
         CreationTime, ModTime,
-        Val.Type, Val.BlockCount, Val.FirstBlockId, Val.Deadline,
-        Dir.HasChildren, Dir.BlockCount, Dir.FirstBlockId,
+        Val.Type, Val.Placement, Val.BlockCount, Val.FirstBlockId, Val.Deadline,
+        Dir.HasChildren, Dir.BlockCount, Dir.IndexLevels, Dir.FirstBlockId,
         Data,
         TSkipMe{ToSkip}
     )
@@ -2,6 +2,8 @@
 
 #include "../saveload.h"
 
+#include <optional>
+
 namespace NJK::NVolume {
 
     // FIXME Align on 64 bytes to be cache lines friendly?
@@ -25,12 +27,19 @@ namespace NJK::NVolume {
             Blob,
         };
 
+        enum class EPlacement: ui8 {
+            Inline, // in Data
+            Blocks, // BlockCount blocks from FirstBlockId
+            Slot, // slot of slab block FirstBlockId, slot index in Data
+        };
+
         // on-disk
         ui32 CreationTime{};
         ui32 ModTime{};
 
         struct {
             EType Type{};
+            EPlacement Placement{};
             ui16 BlockCount = 0; // up to 256 MiB
             ui32 FirstBlockId = 0;
             ui32 Deadline = 0;
@@ -39,11 +48,12 @@ namespace NJK::NVolume {
 
         struct {
             bool HasChildren = false; // FIXME ChildCount?
-            ui16 BlockCount = 0; // FIXME ui8 is enough
+            ui8 BlockCount = 0; // 1 -- leaf or index root block, see TDirIndexBlock
+            ui8 IndexLevels = 0; // 0 -- single leaf block
             ui32 FirstBlockId = 0;
         } Dir;
 
-        char Data[38] = {0};
+        char Data[37] = {0};
 
         static constexpr ui32 ToSkip = 0;
 
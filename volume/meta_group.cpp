@@ -4,11 +4,12 @@
 
 namespace NJK::NVolume {
 
-    TMetaGroup::TMetaGroup(const std::string& file, const TSuperBlock& sb)
+    TMetaGroup::TMetaGroup(const std::string& file, ui32 idx, const TSuperBlock& sb, const TCachedBlockFile::TSettings& cacheSettings)
         : SuperBlock(&sb)
+        , Index(idx)
         , FileName(file)
         , RawFile(FileName, SuperBlock->BlockSize)
-        , File(RawFile)
+        , File(RawFile, cacheSettings)
     {
         TotalFreeInodeCount_ = SuperBlock->MetaGroupInodeCount;
         TotalFreeDataBlockCount_ = SuperBlock->MetaGroupDataBlockCount;
@@ -69,6 +70,15 @@ namespace NJK::NVolume {
         TBufInput in(block.Buf());
         DeserializeFixedVector(in, BlockGroupDescrs_);
 
+        // Load bitmaps of all alive groups in one batch instead of 2 reads per group
+        std::vector<size_t> bitmapBlocks;
+        for (ui32 i = 0; i < BlockGroupDescrs_.size() && BlockGroupDescrs_[i].D.CreationTime; ++i) {
+            const size_t first = CalcBlockGroupOffset(i) / SuperBlock->BlockSize;
+            bitmapBlocks.push_back(first + TBlockGroup::InodesBitmapBlockIndex);
+            bitmapBlocks.push_back(first + TBlockGroup::DataBlocksBitmapBlockIndex);
+        }
+        const auto bitmaps = File.GetBlocks(bitmapBlocks);
+
         for (const auto& bg : BlockGroupDescrs_) {
             if (!bg.D.CreationTime) {
                 break;
@@ -179,6 +189,33 @@ namespace NJK::NVolume {
         }
     }
 
+    i32 TMetaGroup::TryAllocateDataBlocks(ui32 count) {
+        if (count > SuperBlock->BlockGroupDataBlockCount || !TrySub(TotalFreeDataBlockCount_, count)) {
+            return -1;
+        }
+
+        TODO_BETTER_CONCURRENCY
+        std::unique_lock g(Lock_);
+        while (true) {
+            if (TrySub(ExistingFreeDataBlockCount_, count)) {
+                const size_t alive = AliveBlockGroupCount_.load();
+                for (size_t i = alive; i-- > 0; ) {
+                    const i32 id = BlockGroups_[i]->TryAllocateDataBlocks(count);
+                    if (id != -1) {
+                        return id;
+                    }
+                }
+                // Enough free blocks, but not in a row
+                ExistingFreeDataBlockCount_ += count;
+            }
+            if (AliveBlockGroupCount_ == SuperBlock->MaxBlockGroupCount) {
+                TotalFreeDataBlockCount_ += count;
+                return -1;
+            }
+            AllocateNewBlockGroup();
+        }
+    }
+
     void TMetaGroup::DeallocateDataBlock(ui32 id) {
         GetDataBlockGroup(id).DeallocateDataBlock(id);
         ++ExistingFreeDataBlockCount_;
@@ -201,6 +238,45 @@ namespace NJK::NVolume {
         return GetDataBlockGroup(id).GetMutableDataBlock(id);
     }
 
+    TCachedBlockFile::TPage<true> TMetaGroup::GetDataBlockForOverwrite(ui32 id) {
+        return GetDataBlockGroup(id).GetDataBlockForOverwrite(id);
+    }
+
+    std::vector<TCachedBlockFile::TPage<false>> TMetaGroup::GetDataBlocks(ui32 firstId, ui32 count) {
+        return GetDataBlockGroup(firstId).GetDataBlocks(firstId, count);
+    }
+
+    void TMetaGroup::PrefetchInodes(const std::vector<ui32>& ids) {
+        std::vector<size_t> blocks;
+        blocks.reserve(ids.size());
+        for (const ui32 id : ids) {
+            blocks.push_back(GetInodeBlockGroup(id).GetInodeFileBlockIndex(id));
+        }
+        File.Prefetch(std::move(blocks));
+    }
+
+    void TMetaGroup::PrefetchDataBlocks(const std::vector<ui32>& ids) {
+        std::vector<size_t> blocks;
+        blocks.reserve(ids.size());
+        for (const ui32 id : ids) {
+            blocks.push_back(GetDataBlockGroup(id).GetDataFileBlockIndex(id));
+        }
+        File.Prefetch(std::move(blocks));
+    }
+
+    void TMetaGroup::Sync() {
+        {
+            std::unique_lock g(Lock_);
+            UpdateBlockGroupDescriptors();
+            SaveBlockGroupDescriptors();
+            const size_t alive = AliveBlockGroupCount_.load();
+            for (size_t i = 0; i < alive; ++i) {
+                BlockGroups_[i]->Flush();
+            }
+        }
+        File.Sync();
+    }
+
     void TMetaGroup::UpdateBlockGroupDescriptors() {
         size_t alive = AliveBlockGroupCount_.load();
         for (size_t i = 0; i < alive; ++i) {
@@ -220,7 +296,7 @@ namespace NJK::NVolume {
     std::unique_ptr<TBlockGroup> TMetaGroup::CreateBlockGroup(ui32 blockGroupIdx) {
         return std::make_unique<TBlockGroup>(
             CalcBlockGroupOffset(blockGroupIdx) / SuperBlock->BlockSize,
-            blockGroupIdx * SuperBlock->BlockGroupInodeCount, // TODO Add MetaGroup Inode offset
+            Index * SuperBlock->MetaGroupInodeCount + blockGroupIdx * SuperBlock->BlockGroupInodeCount,
             File,
             *SuperBlock,
             BlockGroupDescrs_[blockGroupIdx]
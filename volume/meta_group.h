@@ -12,7 +12,8 @@ namespace NJK::NVolume {
     // One data file up to 2 GiB by default
     class TMetaGroup {
     public:
-        TMetaGroup(const std::string& file, const TSuperBlock& sb);
+        // Inode and data block ids of meta group idx start from idx * MetaGroupInodeCount
+        TMetaGroup(const std::string& file, ui32 idx, const TSuperBlock& sb, const TCachedBlockFile::TSettings& cacheSettings = {});
         ~TMetaGroup();
 
         std::optional<TInode> TryAllocateInode();
@@ -20,6 +21,8 @@ namespace NJK::NVolume {
 
         i32 TryAllocateDataBlock(const TInode& owner);
         i32 TryAllocateDataBlock();
+        // Contiguous in one block group, returns first id
+        i32 TryAllocateDataBlocks(ui32 count);
         void DeallocateDataBlock(ui32);
 
         TInode ReadInode(ui32 id);
@@ -27,6 +30,19 @@ namespace NJK::NVolume {
 
         TCachedBlockFile::TPage<false> GetDataBlock(ui32 id);
         TCachedBlockFile::TPage<true> GetMutableDataBlock(ui32 id);
+        TCachedBlockFile::TPage<true> GetDataBlockForOverwrite(ui32 id);
+        // One vectored read for missing ones
+        std::vector<TCachedBlockFile::TPage<false>> GetDataBlocks(ui32 firstId, ui32 count);
+
+        // Asynchronous hints, see TCachedBlockFile::Prefetch
+        void PrefetchInodes(const std::vector<ui32>& ids);
+        void PrefetchDataBlocks(const std::vector<ui32>& ids);
+
+        TCachedBlockFile::TStats GetCacheStats() const {
+            return File.GetStats();
+        }
+
+        void Sync();
 
     private:
         void AllocateNewBlockGroup();
@@ -50,6 +66,7 @@ namespace NJK::NVolume {
 
     private:
         const TSuperBlock* SuperBlock{};
+        const ui32 Index = 0;
         std::string FileName;
         TBlockDirectIoFile RawFile;
         TCachedBlockFile File;
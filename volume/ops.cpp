@@ -2,6 +2,8 @@
 
 #include "../saveload.h"
 
+#include <algorithm>
+#include <limits>
 #include <variant>
 
 namespace NJK::NVolume {
@@ -14,71 +16,66 @@ namespace NJK::NVolume {
     {
     }
 
-    TVolume::TInode TInodeDataOps::AddChild(TInode& parent, const std::string& name) {
-        // TODO FIXME Don't use Zero Id for Inodes and for Data Blocks -- start from One
-
-        if (parent.Dir.HasChildren) {
-            Y_VERIFY(parent.Dir.BlockCount != 0);
-            auto block = Volume_.GetMutableDataBlock(parent.Dir.FirstBlockId);
-            auto children = DeserializeDirectoryEntries(block.Buf());
-
-            if (std::any_of(children.begin(), children.end(), [&](const TDirEntry& c) { return c.Name == name; })) {
-                throw std::runtime_error("Already has child");
+    namespace {
+        size_t CalcDirectoryEntriesSize(const std::vector<TInodeDataOps::TDirEntry>& entries) {
+            size_t size = TDirLeafBlock::HeaderSize;
+            for (const auto& entry : entries) {
+                size += TDirLeafBlock::GetEntrySize(entry.Name.size());
             }
+            return size;
+        }
+    }
 
-            auto child = Volume_.AllocateInode();
-            children.push_back({child.Id, name});
-
-            SerializeDirectoryEntries(block.Buf(), children);
-            return child;
-        } else {
-            auto child = Volume_.AllocateInode();
-TODO("Allocate with owner inode argument")
-            auto blockId = Volume_.AllocateDataBlock();
-            auto block = Volume_.GetMutableDataBlock(blockId);
-            SerializeDirectoryEntries(block.Buf(), {{child.Id, name}});
+    // Directory is single leaf block while its entries fit into it, then
+    // it's indexed by name hash (see TDirIndexBlock) with Dir.FirstBlockId
+    // being the index root.
+    TVolume::TInode TInodeDataOps::AddChild(TInode& parent, const std::string& name) {
+        // TODO FIXME Don't use Zero Id for Inodes and for Data Blocks -- start from One
 
-            parent.Dir.HasChildren = true;
-            parent.Dir.BlockCount = 1;
-            parent.Dir.FirstBlockId = blockId;
-            Volume_.WriteInode(parent);
-            return child;
+        std::optional<TInode> child;
+        DoEnsureChild(parent, name, child);
+        if (!child) {
+            throw std::runtime_error("Already has child");
         }
+        return *child;
     }
 
     void TInodeDataOps::RemoveChild(TInode& parent, const std::string& name) {
         Y_VERIFY(parent.Dir.HasChildren);
         Y_VERIFY(parent.Dir.BlockCount != 0);
 
-        auto block = Volume_.GetMutableDataBlock(parent.Dir.FirstBlockId);
-        auto children = DeserializeDirectoryEntries(block.Buf());
+        const ui32 hash = TDirIndexBlock::HashName(name);
+        auto path = FindLeaf(parent, hash);
+        {
+            auto block = Volume_.GetMutableDataBlock(path.LeafId);
+            const auto id = TDirLeafBlock::Remove(block.Buf(), name);
+            if (!id) {
+                throw std::runtime_error("Has no such child");
+            }
+            auto child = Volume_.ReadInode(*id);
 
-        // TODO Optimize
-        auto it = std::find_if(children.begin(), children.end(), [&](const TDirEntry& c) { return c.Name == name; });
-        if (it == children.end()) {
-            throw std::runtime_error("Has no such child");
-        }
-        auto childDentry = *it;
-        auto child = Volume_.ReadInode(childDentry.Id);
+            // XXX
+            Y_VERIFY(!child.Dir.HasChildren);
 
-        // XXX
-        Y_VERIFY(!child.Dir.HasChildren);
+            FreeValueStorage(child);
+            Volume_.DeallocateInode(child); // FIXME
 
-        if (child.Val.Type != TInode::EType::Undefined) {
-            Y_FAIL("TODO Remove value data blocks");
+            if (TDirLeafBlock::GetCount(block.Buf())) {
+                if (TDirLeafBlock::NeedsCompaction(block.Buf())) {
+                    TDirLeafBlock::Compact(block.Buf());
+                }
+                return;
+            }
         }
 
-        children.erase(it); // TODO Optimize
-        Volume_.DeallocateInode(child); // FIXME
-
-        if (children.empty()) {
-            Volume_.DeallocateDataBlock(parent.Dir.FirstBlockId);
+        Volume_.DeallocateDataBlock(path.LeafId);
+        if (parent.Dir.IndexLevels) {
+            RemoveIndexEntry(parent, path, path.Index.size() - 1);
+        } else {
             parent.Dir.HasChildren = false;
             parent.Dir.BlockCount = 0;
             parent.Dir.FirstBlockId = 0;
             Volume_.WriteInode(parent);
-        } else {
-            SerializeDirectoryEntries(block.Buf(), children);
         }
     }
 
@@ -89,8 +86,27 @@ TODO("Allocate with owner inode argument")
 
         Y_VERIFY(parent.Dir.BlockCount != 0);
 
-        auto block = Volume_.GetDataBlock(parent.Dir.FirstBlockId);
-        return DeserializeDirectoryEntries(block.Buf());
+        std::vector<ui32> leaves;
+        if (parent.Dir.IndexLevels) {
+            CollectLeaves(parent.Dir.FirstBlockId, parent.Dir.IndexLevels, leaves);
+            Volume_.PrefetchDataBlocks(leaves);
+        } else {
+            leaves.push_back(parent.Dir.FirstBlockId);
+        }
+
+        // Leaves are sorted, but merging them one by one is quadratic in leaf count
+        std::vector<TDirEntry> ret;
+        for (const ui32 leafId : leaves) {
+            auto block = Volume_.GetDataBlock(leafId);
+            auto children = DeserializeDirectoryEntries(block.Buf());
+            ret.insert(ret.end(), std::make_move_iterator(children.begin()), std::make_move_iterator(children.end()));
+        }
+        if (leaves.size() > 1) {
+            std::sort(ret.begin(), ret.end(), [](const TDirEntry& lhs, const TDirEntry& rhs) {
+                return lhs.Name < rhs.Name;
+            });
+        }
+        return ret;
     }
 
     std::optional<TVolume::TInode> TInodeDataOps::LookupChild(const TInode& parent, const std::string& name) {
@@ -99,127 +115,515 @@ TODO("Allocate with owner inode argument")
         }
         Y_VERIFY(parent.Dir.BlockCount != 0);
 
-        auto block = Volume_.GetDataBlock(parent.Dir.FirstBlockId);
-        auto children = DeserializeDirectoryEntries(block.Buf()); // TODO We can lookup without full deserialization
-
-        // TODO Optimize
-        auto it = std::find_if(children.begin(), children.end(), [&](const TDirEntry& c) { return c.Name == name; });
-        if (it == children.end()) {
+        const ui32 hash = TDirIndexBlock::HashName(name);
+        std::optional<ui32> id;
+        {
+            auto block = Volume_.GetDataBlock(FindLeaf(parent, hash).LeafId);
+            id = TDirLeafBlock::Find(block.Buf(), name);
+        }
+        if (!id) {
             return {};
         }
-
-        auto child = *it;
-        return Volume_.ReadInode(child.Id);
+        return Volume_.ReadInode(*id);
     }
 
-    // TODO OPTIMIZE, Do it in less movements
     TVolume::TInode TInodeDataOps::EnsureChild(TInode& parent, const std::string& name) {
-        auto child = LookupChild(parent, name);
-        if (child) {
-            return *child;
+        std::optional<TInode> child;
+        const ui32 id = DoEnsureChild(parent, name, child);
+        return child ? *child : Volume_.ReadInode(id);
+    }
+
+    std::vector<ui32> TInodeDataOps::EnsureChildren(TInode& parent, const std::vector<std::string>& names) {
+        std::vector<ui32> ids;
+        ids.reserve(names.size());
+        for (const auto& name : names) {
+            std::optional<TInode> child;
+            ids.push_back(DoEnsureChild(parent, name, child));
         }
-        return AddChild(parent, name);
+        return ids;
     }
 
-    void TInodeDataOps::SetValue(TInode& inode, const TValue& value, const ui32 deadline) {
-        if (const auto* v = std::get_if<std::monostate>(&value)) {
-            UnsetValue(inode);
+    // Only the new entry is written to the leaf unless it's split
+    ui32 TInodeDataOps::DoEnsureChild(TInode& parent, const std::string& name, std::optional<TInode>& created) {
+        const ui32 hash = TDirIndexBlock::HashName(name);
+
+        if (!parent.Dir.HasChildren) {
+            created = Volume_.AllocateInode();
+TODO("Allocate with owner inode argument")
+            auto blockId = Volume_.AllocateDataBlock();
+            {
+                auto block = Volume_.GetDataBlockForOverwrite(blockId);
+                TDirLeafBlock::Init(block.Buf());
+                Y_ENSURE(TDirLeafBlock::Insert(block.Buf(), created->Id, name));
+            }
+
+            parent.Dir.HasChildren = true;
+            parent.Dir.BlockCount = 1;
+            parent.Dir.FirstBlockId = blockId;
+            Volume_.WriteInode(parent);
+            return created->Id;
+        }
+
+        Y_VERIFY(parent.Dir.BlockCount != 0);
+        auto path = FindLeaf(parent, hash);
+        {
+            // Not to dirty the block if child exists
+            auto block = Volume_.GetDataBlock(path.LeafId);
+            if (const auto id = TDirLeafBlock::Find(block.Buf(), name)) {
+                return *id;
+            }
+        }
+
+        created = Volume_.AllocateInode();
+        auto block = Volume_.GetMutableDataBlock(path.LeafId);
+        if (!TDirLeafBlock::Insert(block.Buf(), created->Id, name)) {
+            auto children = DeserializeDirectoryEntries(block.Buf());
+            children.push_back({created->Id, name});
+            SplitLeaf(parent, path, block.Buf(), children);
+        }
+        return created->Id;
+    }
+
+    TInodeDataOps::TDirPath TInodeDataOps::FindLeaf(const TInode& parent, ui32 hash) {
+        TDirPath path;
+        ui32 blockId = parent.Dir.FirstBlockId;
+        if (parent.Dir.IndexLevels) {
+            path.Index.reserve(parent.Dir.IndexLevels);
+            for (size_t level = 0; level < parent.Dir.IndexLevels; ++level) {
+                auto block = Volume_.GetDataBlock(blockId);
+                const size_t pos = TDirIndexBlock::Find(block.Buf(), hash);
+                path.Index.push_back({blockId, pos});
+                blockId = TDirIndexBlock::GetEntry(block.Buf(), pos).BlockId;
+            }
+        }
+        path.LeafId = blockId;
+        return path;
+    }
+
+    void TInodeDataOps::CollectLeaves(ui32 indexBlockId, size_t levels, std::vector<ui32>& leaves) {
+        std::vector<ui32> ids;
+        {
+            auto block = Volume_.GetDataBlock(indexBlockId);
+            const size_t count = TDirIndexBlock::GetCount(block.Buf());
+            for (size_t i = 0; i < count; ++i) {
+                ids.push_back(TDirIndexBlock::GetEntry(block.Buf(), i).BlockId);
+            }
+        }
+
+        if (levels == 1) {
+            leaves.insert(leaves.end(), ids.begin(), ids.end());
             return;
         }
+        for (const ui32 id : ids) {
+            CollectLeaves(id, levels - 1, leaves);
+        }
+    }
 
-        TODO("Allocate with owner inode argument")
+    // Entries don't fit into the leaf: upper half by name hash goes to
+    // new leaf. Names with equal hash always stay in one leaf.
+    void TInodeDataOps::SplitLeaf(TInode& parent, TDirPath& path, TFixedBuffer& leaf, const std::vector<TDirEntry>& children) {
+        if (!parent.Dir.IndexLevels) {
+            // Single leaf becomes the first one of the index
+            const ui32 rootId = Volume_.AllocateDataBlock();
+            {
+                auto root = Volume_.GetDataBlockForOverwrite(rootId);
+                TDirIndexBlock::Init(root.Buf());
+                TDirIndexBlock::Insert(root.Buf(), 0, {0, path.LeafId});
+            }
+            parent.Dir.FirstBlockId = rootId;
+            parent.Dir.IndexLevels = 1;
+            Volume_.WriteInode(parent);
+            path.Index.push_back({rootId, 0});
+        }
 
-        const auto blockId = inode.Val.BlockCount
-            ?  inode.Val.FirstBlockId
-            :  Volume_.AllocateDataBlock();
+        std::vector<std::pair<ui32, size_t>> order; // hash, index in children
+        order.reserve(children.size());
+        for (size_t i = 0; i < children.size(); ++i) {
+            order.push_back({TDirIndexBlock::HashName(children[i].Name), i});
+        }
+        std::sort(order.begin(), order.end());
 
-        auto block = Volume_.GetMutableDataBlock(blockId);
+        // Near the middle by size, then to the closest hash change
+        const size_t total = CalcDirectoryEntriesSize(children);
+        size_t mid = 0;
+        for (size_t size = TDirLeafBlock::HeaderSize; size < total / 2; ++mid) {
+            size += TDirLeafBlock::GetEntrySize(children[order[mid].second].Name.size());
+        }
+        auto sameHash = [&](size_t i) {
+            return order[i].first == order[i - 1].first;
+        };
+        size_t split = mid;
+        while (split < order.size() && sameHash(split)) {
+            ++split;
+        }
+        if (split == order.size()) {
+            split = mid;
+            while (split > 0 && sameHash(split)) {
+                --split;
+            }
+        }
+        Y_ENSURE(split > 0 && split < order.size()); // too many names with equal hash
 
-        const auto type = static_cast<TInode::EType>(value.index());
-        inode.Val.Type = type;
+        std::vector<TDirEntry> lower;
+        std::vector<TDirEntry> upper;
+        for (size_t i = 0; i < order.size(); ++i) {
+            (i < split ? lower : upper).push_back(children[order[i].second]);
+        }
 
-        if (!inode.Val.BlockCount) {
-            inode.Val.BlockCount = 1;
-            inode.Val.FirstBlockId = blockId;
+TODO("Allocate with owner inode argument")
+        const ui32 newLeafId = Volume_.AllocateDataBlock();
+        {
+            auto block = Volume_.GetDataBlockForOverwrite(newLeafId);
+            SerializeDirectoryEntries(block.Buf(), upper);
         }
-        Volume_.WriteInode(inode);
+        SerializeDirectoryEntries(leaf, lower);
+
+        InsertIndexEntry(parent, path, path.Index.size() - 1, {order[split].first, newLeafId});
+    }
 
-        TBufOutput out(block.Buf());
-        if (const auto* v = std::get_if<ui32>(&value)) {
-            Serialize(out, *v);
-        } else if (const auto* v = std::get_if<float>(&value)) {
-            Serialize(out, *v);
-        } else if (const auto* v = std::get_if<double>(&value)) {
-            Serialize(out, *v);
-        } else if (const auto* v = std::get_if<bool>(&value)) {
-            Serialize(out, *v);
-        } else if (const auto* v = std::get_if<std::string>(&value)) {
-            const ui16 len = v->size();
-            Y_ENSURE(len <= Volume_.GetSuperBlock().BlockSize - sizeof(len));
-            Serialize(out, len);
-            out.Save(v->data(), len);
-        } else if (const auto* v = std::get_if<TBlobView>(&value)) {
-            const ui16 len = v->Size();
-            Y_ENSURE(len <= Volume_.GetSuperBlock().BlockSize - sizeof(len));
-            Serialize(out, len);
-            out.Save(v->Data(), len);
+    // Inserts entry after path.Index[depth], splits full index blocks up to
+    // the root. Full root is moved one level down, so its id never changes.
+    void TInodeDataOps::InsertIndexEntry(TInode& parent, TDirPath& path, size_t depth, const TDirIndexBlock::TEntry& entry) {
+        const auto [blockId, pos] = path.Index[depth];
+        {
+            auto block = Volume_.GetMutableDataBlock(blockId);
+            if (TDirIndexBlock::GetCount(block.Buf()) < TDirIndexBlock::GetCapacity(block.Buf().Size())) {
+                TDirIndexBlock::Insert(block.Buf(), pos + 1, entry);
+                return;
+            }
+        }
+
+        const ui32 newBlockId = Volume_.AllocateDataBlock();
+        ui32 splitHash = 0;
+        {
+            auto block = Volume_.GetMutableDataBlock(blockId);
+            const size_t count = TDirIndexBlock::GetCount(block.Buf());
+            auto newBlock = Volume_.GetDataBlockForOverwrite(newBlockId);
+            if (depth == 0) {
+                Y_ENSURE(parent.Dir.IndexLevels < std::numeric_limits<decltype(parent.Dir.IndexLevels)>::max());
+                TDirIndexBlock::MoveTail(block.Buf(), 0, newBlock.Buf());
+                TDirIndexBlock::Insert(block.Buf(), 0, {0, newBlockId});
+            } else {
+                const size_t half = count / 2;
+                splitHash = TDirIndexBlock::GetEntry(block.Buf(), half).Hash;
+                TDirIndexBlock::MoveTail(block.Buf(), half, newBlock.Buf());
+                if (pos + 1 <= half) {
+                    TDirIndexBlock::Insert(block.Buf(), pos + 1, entry);
+                } else {
+                    TDirIndexBlock::Insert(newBlock.Buf(), pos + 1 - half, entry);
+                }
+            }
+        }
+
+        if (depth == 0) {
+            ++parent.Dir.IndexLevels;
+            Volume_.WriteInode(parent);
+            path.Index[0].second = 0;
+            path.Index.insert(path.Index.begin() + 1, {newBlockId, pos});
+            InsertIndexEntry(parent, path, 1, entry);
         } else {
-            Y_FAIL("TODO TInodeDataOps::SetValue");
+            InsertIndexEntry(parent, path, depth - 1, {splitHash, newBlockId});
         }
     }
 
-    TInodeDataOps::TValue TInodeDataOps::GetValue(const TInode& inode) {
-        if (inode.Val.Type == TInode::EType::Undefined) {
-            Y_VERIFY(!inode.Val.BlockCount);
-            return {};
+    // Removes path.Index[depth] entry, frees emptied index blocks up to the
+    // root. Root with single entry is replaced by its child.
+    void TInodeDataOps::RemoveIndexEntry(TInode& parent, TDirPath& path, size_t depth) {
+        const auto [blockId, pos] = path.Index[depth];
+        size_t count = 0;
+        {
+            auto block = Volume_.GetMutableDataBlock(blockId);
+            const ui32 lowerBound = TDirIndexBlock::GetEntry(block.Buf(), 0).Hash;
+            TDirIndexBlock::Erase(block.Buf(), pos);
+            count = TDirIndexBlock::GetCount(block.Buf());
+            if (pos == 0 && count) {
+                auto first = TDirIndexBlock::GetEntry(block.Buf(), 0);
+                first.Hash = lowerBound;
+                TDirIndexBlock::SetEntry(block.Buf(), 0, first);
+            }
         }
-        Y_VERIFY(inode.Val.BlockCount);
 
-        auto block = Volume_.GetDataBlock(inode.Val.FirstBlockId);
+        if (depth > 0) {
+            if (!count) {
+                Volume_.DeallocateDataBlock(blockId);
+                RemoveIndexEntry(parent, path, depth - 1);
+            }
+            return;
+        }
 
-        using EType = TInode::EType;
+        Y_VERIFY(count);
+        while (parent.Dir.IndexLevels && count == 1) {
+            ui32 childId = 0;
+            {
+                auto root = Volume_.GetMutableDataBlock(blockId);
+                childId = TDirIndexBlock::GetEntry(root.Buf(), 0).BlockId;
+                if (parent.Dir.IndexLevels > 1) {
+                    auto child = Volume_.GetMutableDataBlock(childId);
+                    TDirIndexBlock::MoveTail(child.Buf(), 0, root.Buf());
+                    auto first = TDirIndexBlock::GetEntry(root.Buf(), 0);
+                    first.Hash = 0;
+                    TDirIndexBlock::SetEntry(root.Buf(), 0, first);
+                    count = TDirIndexBlock::GetCount(root.Buf());
+                }
+            }
 
-        TValue ret;
-        TBufInput in(block.Buf());
-        switch (inode.Val.Type) {
-        case EType::Ui32: {
-            ui32 val = 0;
-            Deserialize(in, val);
-            ret = val;
+            if (parent.Dir.IndexLevels == 1) {
+                parent.Dir.FirstBlockId = childId;
+                Volume_.DeallocateDataBlock(blockId);
+            } else {
+                Volume_.DeallocateDataBlock(childId);
+            }
+            --parent.Dir.IndexLevels;
+            Volume_.WriteInode(parent);
         }
-            break;
-        case EType::Float: {
-            float val = 0;
-            Deserialize(in, val);
-            ret = val;
+    }
+
+    namespace {
+        // Same format inline in inode and in data block
+        size_t SerializedValueSize(const TInodeValue& value) {
+            if (std::holds_alternative<ui32>(value) || std::holds_alternative<float>(value)) {
+                return 4;
+            } else if (std::holds_alternative<double>(value)) {
+                return 8;
+            } else if (std::holds_alternative<bool>(value)) {
+                return 1;
+            } else if (const auto* v = std::get_if<std::string>(&value)) {
+                return sizeof(ui16) + v->size();
+            } else if (const auto* v = std::get_if<TBlobView>(&value)) {
+                return sizeof(ui16) + v->Size();
+            }
+            Y_FAIL("TODO SerializedValueSize");
         }
-            break;
-        case EType::Bool: {
-            bool val = false;
-            Deserialize(in, val);
-            ret = val;
+
+        void SerializeValue(TBufOutput& out, const TInodeValue& value) {
+            if (const auto* v = std::get_if<ui32>(&value)) {
+                Serialize(out, *v);
+            } else if (const auto* v = std::get_if<float>(&value)) {
+                Serialize(out, *v);
+            } else if (const auto* v = std::get_if<double>(&value)) {
+                Serialize(out, *v);
+            } else if (const auto* v = std::get_if<bool>(&value)) {
+                Serialize(out, *v);
+            } else if (const auto* v = std::get_if<std::string>(&value)) {
+                const ui16 len = v->size();
+                Serialize(out, len);
+                out.Save(v->data(), len);
+            } else if (const auto* v = std::get_if<TBlobView>(&value)) {
+                const ui16 len = v->Size();
+                Serialize(out, len);
+                out.Save(v->Data(), len);
+            } else {
+                Y_FAIL("TODO TInodeDataOps::SetValue");
+            }
+        }
+
+        TInodeValue DeserializeValue(TBufInput& in, TInode::EType type) {
+            using EType = TInode::EType;
+
+            TInodeValue ret;
+            switch (type) {
+            case EType::Ui32: {
+                ui32 val = 0;
+                Deserialize(in, val);
+                ret = val;
+            }
+                break;
+            case EType::Float: {
+                float val = 0;
+                Deserialize(in, val);
+                ret = val;
+            }
+                break;
+            case EType::Bool: {
+                bool val = false;
+                Deserialize(in, val);
+                ret = val;
+            }
+                break;
+            case EType::Double: {
+                double val = 0;
+                Deserialize(in, val);
+                ret = val;
+            }
+                break;
+            case EType::String:
+            case EType::Blob: { // TBlobView doesn't own data
+                std::string val;
+                ui16 len = 0;
+                Deserialize(in, len);
+                val.resize(len);
+                in.Load(val.data(), len);
+                ret = val;
+            }
+                break;
+            default:
+                Y_FAIL("TODO TInodeDataOps::GetValue");
+            };
+
+            return ret;
+        }
+    }
+
+    namespace {
+        using EPlacement = TInode::EPlacement;
+
+        EPlacement ChoosePlacement(size_t size) {
+            if (size <= sizeof(TInode::Data)) {
+                return EPlacement::Inline;
+            } else if (TSlabBlock::FindSizeClass(size)) {
+                return EPlacement::Slot;
+            }
+            return EPlacement::Blocks;
+        }
+
+        // Blocks placement stores only strings and blobs (others are inline):
+        // ui32 length, then bytes through all the blocks
+        std::string_view GetBytes(const TInodeValue& value) {
+            if (const auto* v = std::get_if<std::string>(&value)) {
+                return *v;
+            } else if (const auto* v = std::get_if<TBlobView>(&value)) {
+                return {v->Data(), v->Size()};
+            }
+            Y_FAIL("TODO Only strings and blobs are stored in blocks");
+        }
+
+        ui32 CalcValueBlockCount(size_t len, size_t blockSize) {
+            const size_t count = (sizeof(ui32) + len + blockSize - 1) / blockSize;
+            Y_ENSURE(count <= std::numeric_limits<decltype(TInode::Val.BlockCount)>::max());
+            return count;
+        }
+
+        TValueSlot GetSlot(const TInode& inode) {
+            TValueSlot slot{inode.Val.FirstBlockId};
+            TBufInput in(inode.Data, sizeof(inode.Data));
+            Deserialize(in, slot.Index);
+            return slot;
+        }
+    }
+
+    // Values that fit into TInode::Data are kept there, small ones share
+    // slab blocks, others get whole block. Moves between them as value
+    // size changes.
+    void TInodeDataOps::SetValue(TInode& inode, const TValue& value, const ui32 deadline) {
+        if (const auto* v = std::get_if<std::monostate>(&value)) {
+            UnsetValue(inode);
+            return;
+        }
+
+        const size_t size = SerializedValueSize(value);
+        const size_t blockSize = Volume_.GetSuperBlock().BlockSize;
+
+        const auto type = static_cast<TInode::EType>(value.index());
+        const auto placement = ChoosePlacement(size);
+        const ui32 blockCount = placement == EPlacement::Blocks ? CalcValueBlockCount(GetBytes(value).size(), blockSize) : 0;
+
+        bool reuse = inode.Val.Type != TInode::EType::Undefined && inode.Val.Placement == placement;
+        if (reuse && placement == EPlacement::Slot) {
+            // Slot of other size class
+            auto block = Volume_.GetDataBlock(inode.Val.FirstBlockId);
+            reuse = TSlabBlock::GetSizeClass(block.Buf()) == TSlabBlock::FindSizeClass(size);
+        } else if (reuse && placement == EPlacement::Blocks) {
+            reuse = inode.Val.BlockCount == blockCount;
+        }
+        if (!reuse) {
+            FreeValueStorage(inode);
+        }
+
+        inode.Val.Type = type;
+        inode.Val.Placement = placement;
+        inode.Val.Deadline = deadline;
+
+        switch (placement) {
+        case EPlacement::Inline: {
+            TBufOutput out(inode.Data, sizeof(inode.Data));
+            SerializeValue(out, value);
+            Volume_.WriteInode(inode);
         }
             break;
-        case EType::Double: {
-            double val = 0;
-            Deserialize(in, val);
-            ret = val;
+        case EPlacement::Slot: {
+            if (!reuse) {
+                const auto slot = Volume_.AllocateValueSlot(size);
+                inode.Val.FirstBlockId = slot.BlockId;
+                TBufOutput out(inode.Data, sizeof(inode.Data));
+                Serialize(out, slot.Index);
+            }
+            Volume_.WriteInode(inode);
+
+            const auto slot = GetSlot(inode);
+            auto block = Volume_.GetMutableDataBlock(slot.BlockId);
+            const auto sizeClass = TSlabBlock::GetSizeClass(block.Buf());
+            const size_t offset = TSlabBlock::GetSlotOffset(block.Buf().Size(), sizeClass, slot.Index);
+            TBufOutput out(block.Buf().MutableData() + offset, TSlabBlock::GetSlotSize(sizeClass));
+            SerializeValue(out, value);
         }
             break;
-        case EType::String: {
-            std::string val;
-            ui16 len = 0;
-            Deserialize(in, len);
-            val.resize(len);
-            in.Load(val.data(), len);
-            ret = val;
+        case EPlacement::Blocks: {
+            TODO("Allocate with owner inode argument")
+            if (!reuse) {
+                inode.Val.BlockCount = blockCount;
+                inode.Val.FirstBlockId = Volume_.AllocateDataBlocks(blockCount);
+            }
+            Volume_.WriteInode(inode);
+
+            // Block by block, without reading old contents
+            const auto bytes = GetBytes(value);
+            const ui32 len = bytes.size();
+            size_t pos = 0;
+            for (ui32 i = 0; i < blockCount; ++i) {
+                auto block = Volume_.GetDataBlockForOverwrite(inode.Val.FirstBlockId + i);
+                TBufOutput out(block.Buf());
+                if (i == 0) {
+                    Serialize(out, len);
+                }
+                const size_t chunk = std::min<size_t>(len - pos, blockSize - (i == 0 ? sizeof(len) : 0));
+                out.Save(bytes.data() + pos, chunk);
+                pos += chunk;
+            }
         }
             break;
-        default:
-            Y_FAIL("TODO TInodeDataOps::GetValue");
-        };
+        }
+    }
 
-        return ret;
+    TInodeDataOps::TValue TInodeDataOps::GetValue(const TInode& inode) {
+        if (inode.Val.Type == TInode::EType::Undefined) {
+            Y_VERIFY(!inode.Val.BlockCount);
+            return {};
+        }
+
+        switch (inode.Val.Placement) {
+        case EPlacement::Inline: {
+            TBufInput in(inode.Data, sizeof(inode.Data));
+            return DeserializeValue(in, inode.Val.Type);
+        }
+        case EPlacement::Slot: {
+            const auto slot = GetSlot(inode);
+            auto block = Volume_.GetDataBlock(slot.BlockId);
+            const auto sizeClass = TSlabBlock::GetSizeClass(block.Buf());
+            const size_t offset = TSlabBlock::GetSlotOffset(block.Buf().Size(), sizeClass, slot.Index);
+            TBufInput in(block.Buf().Data() + offset, TSlabBlock::GetSlotSize(sizeClass));
+            return DeserializeValue(in, inode.Val.Type);
+        }
+        case EPlacement::Blocks: {
+            Y_VERIFY(inode.Val.BlockCount);
+            auto blocks = Volume_.GetDataBlocks(inode.Val.FirstBlockId, inode.Val.BlockCount);
+
+            TBufInput in(blocks[0].Buf());
+            ui32 len = 0;
+            Deserialize(in, len);
+
+            std::string val;
+            val.reserve(len);
+            for (size_t i = 0; i < blocks.size(); ++i) {
+                const size_t offset = i == 0 ? sizeof(len) : 0;
+                const size_t chunk = std::min<size_t>(len - val.size(), blocks[i].Buf().Size() - offset);
+                val.append(blocks[i].Buf().Data() + offset, chunk);
+            }
+            Y_VERIFY(val.size() == len);
+            return val;
+        }
+        }
+        Y_UNREACHABLE;
+        return {};
     }
 
     void TInodeDataOps::UnsetValue(TInode& inode) {
@@ -228,46 +632,50 @@ TODO("Allocate with owner inode argument")
             Y_VERIFY(inode.Val.FirstBlockId == 0);
             return;
         }
-        Y_VERIFY(inode.Val.BlockCount);
-
-        Volume_.DeallocateDataBlock(inode.Val.FirstBlockId);
 
+        FreeValueStorage(inode);
         inode.Val.Type = TInode::EType::Undefined;
+        inode.Val.Deadline = 0;
+        Volume_.WriteInode(inode);
+    }
+
+    // Doesn't write inode
+    void TInodeDataOps::FreeValueStorage(TInode& inode) {
+        if (inode.Val.Type != TInode::EType::Undefined) {
+            switch (inode.Val.Placement) {
+            case EPlacement::Inline:
+                break;
+            case EPlacement::Slot:
+                Volume_.DeallocateValueSlot(GetSlot(inode));
+                break;
+            case EPlacement::Blocks:
+                Y_VERIFY(inode.Val.BlockCount);
+                Volume_.DeallocateDataBlocks(inode.Val.FirstBlockId, inode.Val.BlockCount);
+                break;
+            }
+        }
+
+        inode.Val.Placement = EPlacement::Inline;
         inode.Val.BlockCount = 0;
         inode.Val.FirstBlockId = 0;
-
-        Volume_.WriteInode(inode);
+        std::fill(std::begin(inode.Data), std::end(inode.Data), 0);
     }
 
     std::vector<TInodeDataOps::TDirEntry> TInodeDataOps::DeserializeDirectoryEntries(const TFixedBuffer& buf) {
-        TBufInput in(buf);
-        ui16 count = 0;
-        Deserialize(in, count);
-        Y_VERIFY(count > 0);
         std::vector<TDirEntry> ret;
-        ret.resize(count);
-        for (size_t i = 0; i < count; ++i) {
-            auto& entry = ret[i];
-            Deserialize(in, entry.Id);
-            ui8 len = 0;
-            Deserialize(in, len);
-            entry.Name.resize(len);
-            in.Load(entry.Name.data(), len);
-        }
+        ret.reserve(TDirLeafBlock::GetCount(buf));
+        TDirLeafBlock::ForEach(buf, [&](ui32 id, std::string_view name) {
+            ret.push_back({id, std::string(name)});
+        });
+        Y_VERIFY(!ret.empty());
         return ret;
     }
 
     void TInodeDataOps::SerializeDirectoryEntries(TFixedBuffer& buf, const std::vector<TDirEntry>& entries) {
-        TBufOutput out(buf);
-        ui16 count = entries.size();
-        Y_VERIFY(count > 0);
-        Serialize(out, count);
-        std::vector<TDirEntry> ret;
+        Y_VERIFY(!entries.empty());
+        TDirLeafBlock::Init(buf);
         for (const auto& entry : entries) {
-            Serialize(out, entry.Id);
-            ui8 len = entry.Name.size();
-            Serialize(out, len);
-            out.Save(entry.Name.data(), len);
+            Y_ENSURE(TDirLeafBlock::Insert(buf, entry.Id, entry.Name));
         }
     }
 
@@ -283,18 +691,40 @@ TODO("Allocate with owner inode argument")
     }
 
     void TInodeDataOps::DoDumpTree(std::ostream& out, const TInode& root, size_t offset, bool dumpInodeId) {
-        auto children = ListChildren(root);
-        std::sort(children.begin(), children.end(), [] (const auto& lhs, const auto& rhs) {
-            return lhs.Name < rhs.Name;
-        });
-        for (auto&& childEntry : children) {
+        const auto children = ListChildren(root);
+
+        // Load all children inodes, then all their value and directory blocks
+        // in background, so cold reads overlap with output of previous children
+        std::vector<ui32> ids;
+        ids.reserve(children.size());
+        for (const auto& childEntry : children) {
+            ids.push_back(childEntry.Id);
+        }
+        Volume_.PrefetchInodes(ids);
+
+        std::vector<TInode> inodes;
+        inodes.reserve(children.size());
+        std::vector<ui32> blocks;
+        for (const auto& childEntry : children) {
+            const auto& child = inodes.emplace_back(Volume_.ReadInode(childEntry.Id));
+            if (child.Val.Type != TInode::EType::Undefined && child.Val.Placement != TInode::EPlacement::Inline) {
+                blocks.push_back(child.Val.FirstBlockId);
+            }
+            if (child.Dir.HasChildren) {
+                blocks.push_back(child.Dir.FirstBlockId);
+            }
+        }
+        Volume_.PrefetchDataBlocks(blocks);
+
+        for (size_t childIdx = 0; childIdx < children.size(); ++childIdx) {
+            const auto& childEntry = children[childIdx];
             for (size_t i = 0; i < offset; ++i) {
                 out.put(' ');
                 out.put(' ');
                 out.put(' ');
                 out.put(' ');
             }
-            const auto& child = Volume_.ReadInode(childEntry.Id);
+            const auto& child = inodes[childIdx];
             const auto& value = GetValue(child);
             out << childEntry.Name;
             if (dumpInodeId) {
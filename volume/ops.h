@@ -1,6 +1,8 @@
 #pragma once
 
 #include "volume.h"
+#include "dir_index.h"
+#include "dir_leaf.h"
 #include "value.h"
 
 #include <vector>
@@ -29,6 +31,9 @@ namespace NJK::NVolume {
         void RemoveChild(TInode& parent, const std::string& name);
         std::optional<TInode> LookupChild(const TInode& parent, const std::string& name);
         TInode EnsureChild(TInode& parent, const std::string& name);
+        // Adds missing ones, returns ids of all in the same order
+        std::vector<ui32> EnsureChildren(TInode& parent, const std::vector<std::string>& names);
+        // Sorted by name
         std::vector<TDirEntry> ListChildren(const TInode& parent);
 
         void SetValue(TInode& inode, const TValue& value, const ui32 deadline = 0);
@@ -40,6 +45,23 @@ namespace NJK::NVolume {
         void DoDumpTree(std::ostream& out, const TInode& root, size_t offset, bool dumpInodeId);
 
     private:
+        // Index blocks with entry positions from the root, then the leaf
+        struct TDirPath {
+            std::vector<std::pair<ui32, size_t>> Index;
+            ui32 LeafId = 0;
+        };
+
+        // Returns id of existing child or of new one, which is also put to created
+        ui32 DoEnsureChild(TInode& parent, const std::string& name, std::optional<TInode>& created);
+        TDirPath FindLeaf(const TInode& parent, ui32 nameHash);
+        void CollectLeaves(ui32 indexBlockId, size_t levels, std::vector<ui32>& leaves);
+        void SplitLeaf(TInode& parent, TDirPath& path, TFixedBuffer& leaf, const std::vector<TDirEntry>& children);
+        void InsertIndexEntry(TInode& parent, TDirPath& path, size_t depth, const TDirIndexBlock::TEntry& entry);
+        void RemoveIndexEntry(TInode& parent, TDirPath& path, size_t depth);
+
+        // Frees value block or slot, resets placement
+        void FreeValueStorage(TInode& inode);
+
         // TODO Write Deserialization of:
         // 1. std::string
         // 2. TDirEntry
@@ -0,0 +1,117 @@
+#include "slab.h"
+#include "volume.h"
+
+#include <cstring>
+
+namespace NJK::NVolume {
+
+    /*
+        TSlabBlock
+    */
+
+    ui16 TSlabBlock::GetUsedCount(const TFixedBuffer& buf) {
+        ui16 used = 0;
+        std::memcpy(&used, buf.Data() + 2, sizeof(used));
+        return used;
+    }
+
+    void TSlabBlock::Init(TFixedBuffer& buf, ui8 sizeClass) {
+        Y_VERIFY(sizeClass < ClassCount);
+        const size_t bitmapSize = (GetCapacity(buf.Size(), sizeClass) + 7) / 8;
+        std::memset(buf.MutableData(), 0, HeaderSize + bitmapSize);
+        buf.MutableData()[0] = static_cast<char>(sizeClass);
+    }
+
+    i32 TSlabBlock::Allocate(TFixedBuffer& buf) {
+        const size_t capacity = GetCapacity(buf.Size(), GetSizeClass(buf));
+        ui16 used = GetUsedCount(buf);
+        if (used == capacity) {
+            return -1;
+        }
+
+        auto* bitmap = reinterpret_cast<ui8*>(buf.MutableData() + HeaderSize);
+        for (size_t i = 0; i < capacity; ++i) {
+            auto& b = bitmap[i / 8];
+            const ui8 mask = 1 << (i % 8);
+            if (!(b & mask)) {
+                b |= mask;
+                ++used;
+                std::memcpy(buf.MutableData() + 2, &used, sizeof(used));
+                return i;
+            }
+        }
+        Y_FAIL("UsedCount doesn't match bitmap");
+    }
+
+    ui16 TSlabBlock::Deallocate(TFixedBuffer& buf, size_t index) {
+        Y_VERIFY(index < GetCapacity(buf.Size(), GetSizeClass(buf)));
+
+        auto& b = reinterpret_cast<ui8*>(buf.MutableData() + HeaderSize)[index / 8];
+        const ui8 mask = 1 << (index % 8);
+        Y_VERIFY(b & mask);
+        b &= ~mask;
+
+        ui16 used = GetUsedCount(buf);
+        --used;
+        std::memcpy(buf.MutableData() + 2, &used, sizeof(used));
+        return used;
+    }
+
+    /*
+        TSlabAllocator
+    */
+
+    TSlabAllocator::TSlabAllocator(TVolume* volume)
+        : Volume_(*volume)
+    {
+    }
+
+    TValueSlot TSlabAllocator::Allocate(size_t size) {
+        const auto sizeClass = TSlabBlock::FindSizeClass(size);
+        Y_VERIFY(sizeClass);
+
+        auto& cls = Classes_[*sizeClass];
+        std::unique_lock g(cls.Lock);
+        while (!cls.Partial.empty()) {
+            const ui32 blockId = *cls.Partial.begin();
+            auto block = Volume_.GetMutableDataBlock(blockId);
+            const i32 index = TSlabBlock::Allocate(block.Buf());
+            if (index != -1) {
+                return {blockId, static_cast<ui16>(index)};
+            }
+            cls.Partial.erase(cls.Partial.begin());
+        }
+
+        // Nothing to read, the whole block is initialized here
+        const ui32 blockId = Volume_.AllocateDataBlock();
+        auto block = Volume_.GetDataBlockForOverwrite(blockId);
+        TSlabBlock::Init(block.Buf(), *sizeClass);
+        const i32 index = TSlabBlock::Allocate(block.Buf());
+        Y_VERIFY(index == 0);
+        cls.Partial.insert(blockId);
+        return {blockId, 0};
+    }
+
+    void TSlabAllocator::Deallocate(const TValueSlot& slot) {
+        // Size class of block doesn't change while the slot is used,
+        // so it's read before the lock
+        const ui8 sizeClass = TSlabBlock::GetSizeClass(Volume_.GetDataBlock(slot.BlockId).Buf());
+        Y_VERIFY(sizeClass < TSlabBlock::ClassCount);
+
+        auto& cls = Classes_[sizeClass];
+        std::unique_lock g(cls.Lock);
+        bool empty = false;
+        {
+            auto block = Volume_.GetMutableDataBlock(slot.BlockId);
+            empty = TSlabBlock::Deallocate(block.Buf(), slot.Index) == 0;
+        }
+
+        if (empty) {
+            cls.Partial.erase(slot.BlockId);
+            Volume_.DeallocateDataBlock(slot.BlockId);
+        } else {
+            cls.Partial.insert(slot.BlockId);
+        }
+    }
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "../common.h"
+#include "../fixed_buffer.h"
+
+#include <mutex>
+#include <optional>
+#include <unordered_set>
+
+namespace NJK {
+    class TVolume;
+}
+
+namespace NJK::NVolume {
+
+    // Place of value in a data block shared with other values
+    struct TValueSlot {
+        ui32 BlockId = 0;
+        ui16 Index = 0;
+    };
+
+    // Data block split into slots of one size class:
+    //   ui8 SizeClass, ui8 Reserved, ui16 UsedCount, bitmap of used slots, slots
+    class TSlabBlock {
+    public:
+        static constexpr size_t MinSlotSize = 64;
+        static constexpr ui8 ClassCount = 5; // up to 1 KiB, bigger ones get whole block
+        static constexpr size_t HeaderSize = 4;
+
+        static size_t GetSlotSize(ui8 sizeClass) {
+            return MinSlotSize << sizeClass;
+        }
+
+        static std::optional<ui8> FindSizeClass(size_t size) {
+            for (ui8 c = 0; c < ClassCount; ++c) {
+                if (size <= GetSlotSize(c)) {
+                    return c;
+                }
+            }
+            return {};
+        }
+
+        static size_t GetCapacity(size_t blockSize, ui8 sizeClass) {
+            // Each slot costs its size and one bit
+            return (blockSize - HeaderSize) * 8 / (GetSlotSize(sizeClass) * 8 + 1);
+        }
+
+        static size_t GetSlotOffset(size_t blockSize, ui8 sizeClass, size_t index) {
+            const size_t bitmapSize = (GetCapacity(blockSize, sizeClass) + 7) / 8;
+            return HeaderSize + bitmapSize + index * GetSlotSize(sizeClass);
+        }
+
+        static ui8 GetSizeClass(const TFixedBuffer& buf) {
+            return static_cast<ui8>(buf.Data()[0]);
+        }
+
+        static ui16 GetUsedCount(const TFixedBuffer& buf);
+
+        static void Init(TFixedBuffer& buf, ui8 sizeClass);
+        // Returns -1 if full
+        static i32 Allocate(TFixedBuffer& buf);
+        // Returns count of still used slots
+        static ui16 Deallocate(TFixedBuffer& buf, size_t index);
+    };
+
+    // Keeps in memory slab blocks with free slots. After restart blocks are
+    // found again only when some of their slots are freed.
+    class TSlabAllocator {
+    public:
+        explicit TSlabAllocator(TVolume* volume);
+
+        // size is one of TSlabBlock size classes
+        TValueSlot Allocate(size_t size);
+        void Deallocate(const TValueSlot& slot);
+
+    private:
+        // Blocks of different size classes never share a lock
+        struct TSizeClass {
+            std::mutex Lock;
+            std::unordered_set<ui32> Partial;
+        };
+
+        TVolume& Volume_;
+        TSizeClass Classes_[TSlabBlock::ClassCount];
+    };
+
+}
@@ -14,7 +14,8 @@ namespace NJK::NVolume {
         BlockGroupInodeCount,
         BlockGroupDataBlockCount,
         MetaGroupInodeCount,
-        MetaGroupDataBlockCount
+        MetaGroupDataBlockCount,
+        FormatVersion
     );
 
 }
\ No newline at end of file
@@ -17,6 +17,10 @@ namespace NJK::NVolume {
         ui32 BlockGroupDataBlockCount = 0;
         ui32 MetaGroupInodeCount = 0;
         ui32 MetaGroupDataBlockCount = 0;
+        // Images of other versions have incompatible inode and directory layouts
+        ui32 FormatVersion = 0;
+
+        static constexpr ui32 CurrentFormatVersion = 1;
 
         Y_DECLARE_SERIALIZATION
 
@@ -24,7 +28,7 @@ namespace NJK::NVolume {
             return TFixedBuffer::Aligned(BlockSize);
         }
 
-        static constexpr ui32 OnDiskSize = 48;
+        static constexpr ui32 OnDiskSize = 52;
     };
 
 }
\ No newline at end of file
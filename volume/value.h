@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../common.h"
+#include <algorithm>
 #include <variant>
 
 namespace NJK::NVolume {
@@ -32,6 +33,10 @@ namespace NJK::NVolume {
             return Ptr_;
         }
 
+        bool operator== (const TBlobView& other) const {
+            return Size_ == other.Size_ && std::equal(Ptr_, Ptr_ + Size_, other.Ptr_);
+        }
+
     private:
         const char* Ptr_{};
         size_t Size_ = 0;
@@ -30,6 +30,7 @@ namespace NJK {
 
         ui32 AllocateDataBlock();
         ui32 AllocateDataBlock(const TInode& owner);
+        ui32 AllocateDataBlocks(ui32 count);
 
         void DeallocateDataBlock(ui32 id) {
             GetDataBlockMetaGroup(id).DeallocateDataBlock(id);
@@ -62,10 +63,62 @@ namespace NJK {
             return GetDataBlockMetaGroup(id).GetMutableDataBlock(id);
         }
 
+        TCachedBlockFile::TPage<true> GetDataBlockForOverwrite(ui32 id) {
+            return GetDataBlockMetaGroup(id).GetDataBlockForOverwrite(id);
+        }
+
+        std::vector<TCachedBlockFile::TPage<false>> GetDataBlocks(ui32 firstId, ui32 count) {
+            return GetDataBlockMetaGroup(firstId).GetDataBlocks(firstId, count);
+        }
+
+        void PrefetchInodes(const std::vector<ui32>& ids) {
+            ForEachMetaGroup(ids, SuperBlock_.MetaGroupInodeCount, [](TMetaGroup& mg, const std::vector<ui32>& ids) {
+                mg.PrefetchInodes(ids);
+            });
+        }
+
+        void PrefetchDataBlocks(const std::vector<ui32>& ids) {
+            ForEachMetaGroup(ids, SuperBlock_.MetaGroupDataBlockCount, [](TMetaGroup& mg, const std::vector<ui32>& ids) {
+                mg.PrefetchDataBlocks(ids);
+            });
+        }
+
+        // Calls f(metaGroup, idsOfMetaGroup), ids are usually from one or two meta groups
+        template <typename F>
+        void ForEachMetaGroup(const std::vector<ui32>& ids, ui32 perMetaGroup, F&& f) {
+            std::vector<ui32> part;
+            std::vector<bool> done(ids.size());
+            for (size_t i = 0; i < ids.size(); ++i) {
+                if (done[i]) {
+                    continue;
+                }
+                const ui32 mg = ids[i] / perMetaGroup;
+                part.clear();
+                for (size_t j = i; j < ids.size(); ++j) {
+                    if (!done[j] && ids[j] / perMetaGroup == mg) {
+                        part.push_back(ids[j]);
+                        done[j] = true;
+                    }
+                }
+                f(*MetaGroups_[mg], part);
+            }
+        }
+
         void InitSuperBlock(const TSettings& settings);
 
         std::unique_ptr<TMetaGroup> CreateMetaGroup(size_t idx) {
-            return std::make_unique<TMetaGroup>(MakeMetaGroupFilePath(idx), SuperBlock_);
+            return MakeMetaGroup(MakeMetaGroupFilePath(idx), idx);
+        }
+
+        std::unique_ptr<TMetaGroup> MakeMetaGroup(const std::string& path, size_t idx) {
+            TCachedBlockFile::TSettings cacheSettings;
+            cacheSettings.Capacity = Settings_.BlockCacheSize / SuperBlock_.BlockSize;
+            cacheSettings.Shards = Settings_.BlockCacheShards;
+            cacheSettings.FlushInterval = std::chrono::milliseconds(Settings_.FlushIntervalMs);
+            cacheSettings.MaxDirtyRatio = Settings_.MaxDirtyRatio;
+            cacheSettings.ReadaheadMax = Settings_.ReadaheadBlocks;
+            cacheSettings.ReadaheadMin = std::min<size_t>(cacheSettings.ReadaheadMin, Settings_.ReadaheadBlocks);
+            return std::make_unique<TMetaGroup>(path, idx, SuperBlock_, cacheSettings);
         }
 
         void LoadMetaGroups() {
@@ -74,7 +127,7 @@ namespace NJK {
                 if (!std::filesystem::exists(path)) {
                     break;
                 }
-                MetaGroups_.push_back(std::make_unique<TMetaGroup>(path, SuperBlock_));
+                MetaGroups_.push_back(MakeMetaGroup(path, i));
                 ++AliveMetaGroupCount_;
             }
         }
@@ -95,6 +148,22 @@ namespace NJK {
             return SuperBlock_;
         }
 
+        TCachedBlockFile::TStats GetCacheStats() const {
+            TCachedBlockFile::TStats ret;
+            const size_t alive = AliveMetaGroupCount_.load();
+            for (size_t i = 0; i < alive; ++i) {
+                ret += MetaGroups_[i]->GetCacheStats();
+            }
+            return ret;
+        }
+
+        void Sync() {
+            const size_t alive = AliveMetaGroupCount_.load();
+            for (size_t i = 0; i < alive; ++i) {
+                MetaGroups_[i]->Sync();
+            }
+        }
+
         const std::string& GetFsDir() const {
             return Directory_;
         }
@@ -112,6 +181,7 @@ namespace NJK {
 
     private:
         std::string Directory_;
+        TSettings Settings_;
         TSuperBlock SuperBlock_;
         std::atomic<size_t> AliveMetaGroupCount_{0};
         std::mutex Lock_;
@@ -120,6 +190,7 @@ namespace NJK {
 
     TVolume::TImpl::TImpl(const std::string& dir, const TSettings& settings, bool ensureRoot)
         : Directory_(dir)
+        , Settings_(settings)
     {
         // We can implement this similar to std::deque (fixed vector of fixed vectors)
         // but in fixed capacity (that anyway will overcome any reasonable requirements)
@@ -159,6 +230,7 @@ namespace NJK {
         sb.BlockGroupDataBlockCount = sb.BlockSize * 8;
         sb.MetaGroupInodeCount = sb.BlockGroupInodeCount * sb.MaxBlockGroupCount;
         sb.MetaGroupDataBlockCount = sb.BlockGroupDataBlockCount * sb.MaxBlockGroupCount;
+        sb.FormatVersion = TSuperBlock::CurrentFormatVersion;
         return sb;
     }
 
@@ -170,10 +242,13 @@ namespace NJK {
             f.ReadBlock(buf, 0);
             TBufInput in(buf);
             SuperBlock_.Deserialize(in);
+            // No migration of older images
+            Y_ENSURE(SuperBlock_.FormatVersion == TSuperBlock::CurrentFormatVersion);
         } else {
             SuperBlock_ = CalcSuperBlock(settings);
             std::filesystem::create_directories(Directory_);
             auto buf = SuperBlock_.NewBuffer();
+            buf.FillZeroes();
             TBufOutput out(buf);
             SuperBlock_.Serialize(out);
             TBlockDirectIoFile f(sbPath, SuperBlock_.BlockSize);
@@ -195,7 +270,7 @@ namespace NJK {
             size_t alive = 0;
 
             while (true) {
-                const size_t alive = AliveMetaGroupCount_.load();
+                alive = AliveMetaGroupCount_.load();
                 //for (size_t i = 0; i < alive; ++i)
                 {
                     auto inode = MetaGroups_[alive - 1]->TryAllocateInode();
@@ -226,6 +301,25 @@ namespace NJK {
         return AllocateDataBlock();
     }
 
+    ui32 TVolume::TImpl::AllocateDataBlocks(ui32 count) {
+        Y_ENSURE(count && count <= SuperBlock_.BlockGroupDataBlockCount);
+        while (true) {
+            const size_t alive = AliveMetaGroupCount_.load();
+            for (size_t i = alive; i-- > 0; ) {
+                const i32 id = MetaGroups_[i]->TryAllocateDataBlocks(count);
+                if (id != -1) {
+                    return id;
+                }
+            }
+
+            std::unique_lock g(Lock_);
+            if (alive == AliveMetaGroupCount_.load()) {
+                MetaGroups_.push_back(CreateMetaGroup(alive));
+                ++AliveMetaGroupCount_;
+            }
+        }
+    }
+
     ui32 TVolume::TImpl::AllocateDataBlock() {
         while (true) {
             // TODO First try last, than random
@@ -238,7 +332,7 @@ namespace NJK {
             size_t alive = 0;
 
             while (true) {
-                const size_t alive = AliveMetaGroupCount_.load();
+                alive = AliveMetaGroupCount_.load();
                 {
                     i32 id = MetaGroups_[alive - 1]->TryAllocateDataBlock();
                     if (id != -1) {
@@ -267,6 +361,7 @@ namespace NJK {
 
     TVolume::TVolume(const std::string& dir, const TSettings& settings, bool ensureRoot)
         : Impl_(new TImpl(dir, settings, ensureRoot))
+        , Slabs_(new TSlabAllocator(this))
     {
     }
 
@@ -302,6 +397,24 @@ namespace NJK {
         Impl_->DeallocateDataBlock(id);
     }
 
+    ui32 TVolume::AllocateDataBlocks(ui32 count) {
+        return Impl_->AllocateDataBlocks(count);
+    }
+
+    void TVolume::DeallocateDataBlocks(ui32 firstId, ui32 count) {
+        for (ui32 i = 0; i < count; ++i) {
+            Impl_->DeallocateDataBlock(firstId + i);
+        }
+    }
+
+    TValueSlot TVolume::AllocateValueSlot(size_t size) {
+        return Slabs_->Allocate(size);
+    }
+
+    void TVolume::DeallocateValueSlot(const TValueSlot& slot) {
+        Slabs_->Deallocate(slot);
+    }
+
     TCachedBlockFile::TPage<false> TVolume::GetDataBlock(ui32 id) {
         return Impl_->GetDataBlock(id);
     }
@@ -310,6 +423,30 @@ namespace NJK {
         return Impl_->GetMutableDataBlock(id);
     }
 
+    TCachedBlockFile::TPage<true> TVolume::GetDataBlockForOverwrite(ui32 id) {
+        return Impl_->GetDataBlockForOverwrite(id);
+    }
+
+    std::vector<TCachedBlockFile::TPage<false>> TVolume::GetDataBlocks(ui32 firstId, ui32 count) {
+        return Impl_->GetDataBlocks(firstId, count);
+    }
+
+    void TVolume::PrefetchInodes(const std::vector<ui32>& ids) {
+        Impl_->PrefetchInodes(ids);
+    }
+
+    void TVolume::PrefetchDataBlocks(const std::vector<ui32>& ids) {
+        Impl_->PrefetchDataBlocks(ids);
+    }
+
+    TCachedBlockFile::TStats TVolume::GetCacheStats() const {
+        return Impl_->GetCacheStats();
+    }
+
+    void TVolume::Sync() {
+        Impl_->Sync();
+    }
+
     const TSuperBlock& TVolume::GetSuperBlock() const {
         return Impl_->GetSuperBlock();
     }
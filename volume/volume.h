@@ -4,9 +4,11 @@
 #include "../block_file.h"
 #include "super_block.h"
 #include "inode.h"
+#include "slab.h"
 
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace NJK {
 
@@ -21,6 +23,11 @@ namespace NJK {
         ui32 BlockSize = 4096;
         ui32 NameMaxLen = 32; // or 64 TODO Not used
         ui32 MaxFileSize = 2_GiB;
+        size_t BlockCacheSize = 256_MiB; // per meta group file, 0 means unbounded
+        ui32 BlockCacheShards = 0; // per meta group file, 0 means one per hardware thread
+        ui32 FlushIntervalMs = 1000; // background write-back of dirty blocks, 0 disables
+        float MaxDirtyRatio = 0.1; // of BlockCacheSize, starts write-back before FlushIntervalMs
+        ui32 ReadaheadBlocks = 64; // max sequential readahead window, 0 disables
     };
 
     class TVolume {
@@ -43,9 +50,29 @@ namespace NJK {
         ui32 AllocateDataBlock();
         ui32 AllocateDataBlock(const TInode& owner);
         void DeallocateDataBlock(ui32);
+        // Contiguous, up to BlockGroupDataBlockCount, returns first id
+        ui32 AllocateDataBlocks(ui32 count);
+        void DeallocateDataBlocks(ui32 firstId, ui32 count);
+
+        // For values smaller than block, see TSlabBlock for sizes
+        NVolume::TValueSlot AllocateValueSlot(size_t size);
+        void DeallocateValueSlot(const NVolume::TValueSlot& slot);
 
         TCachedBlockFile::TPage<false> GetDataBlock(ui32 id);
         TCachedBlockFile::TPage<true> GetMutableDataBlock(ui32 id);
+        // Whole block will be written, so it's not read from disk
+        TCachedBlockFile::TPage<true> GetDataBlockForOverwrite(ui32 id);
+        // Blocks allocated by one AllocateDataBlocks, read at once
+        std::vector<TCachedBlockFile::TPage<false>> GetDataBlocks(ui32 firstId, ui32 count);
+
+        // Start loading in background, ReadInode/GetDataBlock will wait less
+        void PrefetchInodes(const std::vector<ui32>& ids);
+        void PrefetchDataBlocks(const std::vector<ui32>& ids);
+
+        TCachedBlockFile::TStats GetCacheStats() const;
+
+        // Writes all modified blocks and allocation bitmaps to disk
+        void Sync();
 
         const TSuperBlock& GetSuperBlock() const;
         static TSuperBlock CalcSuperBlock(const TSettings& settings);
@@ -55,6 +82,7 @@ namespace NJK {
     private:
         class TImpl;
         std::unique_ptr<TImpl> Impl_;
+        std::unique_ptr<NVolume::TSlabAllocator> Slabs_;
     };
 
     using TVolumePtr = std::unique_ptr<TVolume>;